@@ -23,6 +23,7 @@
 #include "ApiCommandParser.h"
 #include "ByteOrder.h"
 #include "Options.h"
+#include "ValueMetadata.h"
 
 /* version of our command API */
 #define API_VERSION "2016030701"
@@ -39,7 +40,10 @@ ApiCommandParser::ApiCommandParser(EmsCommandSender& sender,
     m_outputCb(outputCb),
     m_responseCounter(0),
     m_parsePosition(0),
-    m_outputRawData(false)
+    m_outputRawData(false),
+    m_watching(false),
+    m_watchGeneration(0),
+    m_watchTimeout(0)
 {
 }
 
@@ -58,7 +62,7 @@ static const size_t dayNameCount = sizeof(dayNames) / sizeof(dayNames[0]);
 ApiCommandParser::CommandResult
 ApiCommandParser::parse(std::istream& request)
 {
-    if (m_activeRequest) {
+    if (m_activeRequest || m_watching) {
 	return Busy;
     }
 
@@ -421,6 +425,41 @@ ApiCommandParser::handleRawCommand(std::istream& request)
 }
 #endif
 
+/*
+ * Reads the remaining words as cache selector, except for a trailing
+ * number, which is stored in number (if given). Value names may start
+ * with digits, but never consist of digits only. Fails for numbers out
+ * of range and for selectors ValueMetadata::selectValues() rejects.
+ */
+template<typename T> static bool
+parseSelector(std::istream& request, std::vector<std::string>& selector, T *number)
+{
+    std::string token;
+
+    while (request >> token) {
+	selector.push_back(token);
+    }
+
+    if (number && !selector.empty() &&
+	    selector.back().find_first_not_of("0123456789") == std::string::npos) {
+	try {
+	    *number = boost::lexical_cast<T>(selector.back());
+	} catch (boost::bad_lexical_cast& e) {
+	    return false;
+	}
+	selector.pop_back();
+    }
+
+    EmsValueMask mask;
+    return ValueMetadata::selectValues(selector, mask);
+}
+
+static bool
+parseSelector(std::istream& request, std::vector<std::string>& selector)
+{
+    return parseSelector<int>(request, selector, NULL);
+}
+
 ApiCommandParser::CommandResult
 ApiCommandParser::handleCacheCommand(std::istream& request)
 {
@@ -431,18 +470,59 @@ ApiCommandParser::handleCacheCommand(std::istream& request)
 	if (cmd == "help") {
 	    output("Available subcommands:\n"
 		   "fetch <key>\n"
+		   "history <key> [<since timestamp>]\n"
+		   "since <generation> [<key>]\n"
+		   "watch <key> [<timeout in s>]\n"
 		   "OK");
 	    return Ok;
+	} else if (cmd == "history") {
+	    std::ostringstream stream;
+	    std::vector<std::string> selector;
+	    time_t since = 0;
+
+	    if (!parseSelector(request, selector, &since)) {
+		return InvalidArgs;
+	    }
+
+	    m_cache->outputHistory(selector, since, stream);
+	    output(stream.str());
+	    output("OK");
+	    return Ok;
+	} else if (cmd == "since") {
+	    std::ostringstream stream;
+	    std::vector<std::string> selector;
+	    uint64_t since;
+
+	    request >> since;
+	    if (!request || !parseSelector(request, selector)) {
+		return InvalidArgs;
+	    }
+
+	    uint64_t generation = m_cache->outputChanges(selector, since, stream);
+	    output(stream.str());
+	    output("generation " + boost::lexical_cast<std::string>(generation));
+	    output("OK");
+	    return Ok;
+	} else if (cmd == "watch") {
+	    std::vector<std::string> selector;
+	    unsigned int timeout = DefaultWatchTimeout;
+
+	    if (!parseSelector(request, selector, &timeout)) {
+		return InvalidArgs;
+	    }
+
+	    /* answered by onValuesChanged() or onWatchTimeout() */
+	    m_watching = true;
+	    m_watchSelector = selector;
+	    m_watchGeneration = m_cache->generation();
+	    m_watchTimeout = timeout;
+	    return Ok;
 	} else if (cmd == "fetch") {
 	    std::ostringstream stream;
 	    std::vector<std::string> selector;
 
-	    while (request) {
-		std::string token;
-		request >> token;
-		if (!token.empty()) {
-		    selector.push_back(token);
-		}
+	    if (!parseSelector(request, selector)) {
+		return InvalidArgs;
 	    }
 
 	    m_cache->outputValues(selector, stream);
@@ -1037,7 +1117,8 @@ ApiCommandParser::onIncomingMessage(const EmsMessage& message)
 	return boost::indeterminate;
     }
 
-    const std::vector<uint8_t>& data = message.getData();
+    const uint8_t *data = message.getData();
+    size_t length = message.getDataLength();
     uint8_t source = message.getSource();
     uint8_t type = message.getType();
     uint8_t offset = message.getOffset();
@@ -1049,7 +1130,9 @@ ApiCommandParser::onIncomingMessage(const EmsMessage& message)
 					 m_activeRequest->getDestination(),
 					 m_activeRequest->getType(),
 					 m_activeRequest->getOffset(),
-					 m_activeRequest->getData(),
+					 std::vector<uint8_t>(m_activeRequest->getData(),
+							      m_activeRequest->getData() +
+							      m_activeRequest->getDataLength()),
 					 false);
 	    m_msgHandler.handleIncomingMessage(simulatedResponse.getSendData(false));
 	}
@@ -1064,11 +1147,11 @@ ApiCommandParser::onIncomingMessage(const EmsMessage& message)
 	return boost::indeterminate;
     }
 
-    if (data.empty()) {
+    if (length == 0) {
 	// no more data is available
 	m_requestLength = m_requestResponse.size();
     } else {
-	m_requestResponse.insert(m_requestResponse.end(), data.begin(), data.end());
+	m_requestResponse.insert(m_requestResponse.end(), data, data + length);
     }
 
     boost::tribool result;
@@ -1290,6 +1373,40 @@ ApiCommandParser::onTimeout()
     return false;
 }
 
+void
+ApiCommandParser::onValuesChanged()
+{
+    if (!m_watching || m_cache->generation() == m_watchGeneration) {
+	return;
+    }
+
+    std::ostringstream stream;
+    uint64_t generation = m_cache->outputChanges(m_watchSelector, m_watchGeneration, stream);
+    if (stream.tellp() == 0) {
+	/* only other values changed, no need to look at them again */
+	m_watchGeneration = generation;
+	return;
+    }
+
+    output(stream.str());
+    output("generation " + boost::lexical_cast<std::string>(generation));
+    output("OK");
+    m_watching = false;
+}
+
+void
+ApiCommandParser::onWatchTimeout()
+{
+    if (!m_watching) {
+	return;
+    }
+
+    /* no matching changes, but the client may continue with 'cache since' */
+    output("generation " + boost::lexical_cast<std::string>(m_watchGeneration));
+    output("OK");
+    m_watching = false;
+}
+
 std::string
 ApiCommandParser::buildRecordResponse(const EmsProto::ErrorRecord *record)
 {
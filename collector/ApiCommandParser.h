@@ -47,6 +47,17 @@ class ApiCommandParser : public boost::noncopyable
 	boost::tribool onIncomingMessage(const EmsMessage& message);
 	bool onTimeout();
 
+	/* a 'cache watch' command waits for matching values to change */
+	bool isWatching() const {
+	    return m_watching;
+	}
+	unsigned int watchTimeout() const {
+	    return m_watchTimeout;
+	}
+	/* to be called after the cache handled new values */
+	void onValuesChanged();
+	void onWatchTimeout();
+
     public:
 	static std::string buildRecordResponse(const EmsProto::ErrorRecord *record);
 	static std::string buildRecordResponse(const EmsProto::ScheduleEntry *entry);
@@ -90,6 +101,8 @@ class ApiCommandParser : public boost::noncopyable
 
     private:
 	static const unsigned int MaxRequestRetries = 5;
+	/* in seconds */
+	static const unsigned int DefaultWatchTimeout = 60;
 
 	EmsCommandSender& m_sender;
 	IncomingMessageHandler& m_msgHandler;
@@ -106,6 +119,11 @@ class ApiCommandParser : public boost::noncopyable
 	uint8_t m_requestType;
 	size_t m_parsePosition;
 	bool m_outputRawData;
+	bool m_watching;
+	std::vector<std::string> m_watchSelector;
+	/* values changed up to this generation don't match the selector */
+	uint64_t m_watchGeneration;
+	unsigned int m_watchTimeout;
 };
 
 #endif /* __APICOMMANDPARSER_H__ */
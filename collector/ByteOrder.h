@@ -22,10 +22,14 @@
 
 #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
 #define BE16_TO_CPU(x) ((uint16_t)((((uint16_t)(x) & 0x00ffU) << 8) | (((uint16_t)(x) & 0xff00U) >> 8)))
+#define LE32_TO_CPU(x) (x)
 #elif __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
 #define BE16_TO_CPU(x) (x)
+#define LE32_TO_CPU(x) __builtin_bswap32(x)
 #else
 #error Unknown byte order
 #endif
 
+#define CPU_TO_LE32(x) LE32_TO_CPU(x)
+
 #endif /* __BYTE_ORDER_H__ */
@@ -19,6 +19,7 @@
 
 #include <boost/bind/bind.hpp>
 #include <iostream>
+#include <sstream>
 #include "CommandHandler.h"
 
 CommandHandler::CommandHandler(boost::asio::io_service& ios,
@@ -72,6 +73,15 @@ CommandHandler::stopConnection(CommandConnection::Ptr connection)
     connection->close();
 }
 
+void
+CommandHandler::handleValues(const EmsValueBatch& /* values */)
+{
+    /* answering a watch doesn't stop the connection, so iterating is safe */
+    for (auto& connection : m_connections) {
+	connection->onValuesChanged();
+    }
+}
+
 void
 CommandHandler::startAccepting()
 {
@@ -91,7 +101,8 @@ CommandConnection::CommandConnection(boost::asio::io_service& ios,
     m_commandClient(new CommandClient(this)),
     m_parser(sender, msgHandler, m_commandClient, cache,
 	     boost::bind(&CommandConnection::respond, this, boost::placeholders::_1)),
-    m_handler(handler)
+    m_handler(handler),
+    m_watchTimer(ios)
 {
 }
 
@@ -105,9 +116,13 @@ CommandConnection::handleRequest(const boost::system::error_code& error)
 	return;
     }
 
+    /* the buffer may contain further requests, which must not be parsed as arguments */
     std::istream requestStream(&m_request);
-    ApiCommandParser::CommandResult result = m_request.size() > 2
-	    ? m_parser.parse(requestStream) : ApiCommandParser::InvalidCmd;
+    std::string line;
+    std::getline(requestStream, line);
+    std::istringstream lineStream(line);
+    ApiCommandParser::CommandResult result = line.size() > 1
+	    ? m_parser.parse(lineStream) : ApiCommandParser::InvalidCmd;
 
     switch (result) {
 	case ApiCommandParser::Ok:
@@ -123,16 +138,18 @@ CommandConnection::handleRequest(const boost::system::error_code& error)
 	    break;
     }
 
-    requestStream.clear();
-    /* drain remainder */
-    std::string remainder;
-    std::getline(requestStream, remainder);
+    if (result == ApiCommandParser::Ok && m_parser.isWatching()) {
+	m_watchTimer.expires_from_now(boost::posix_time::seconds(m_parser.watchTimeout()));
+	m_watchTimer.async_wait(boost::bind(&CommandConnection::handleWatchTimeout,
+					    shared_from_this(), boost::asio::placeholders::error));
+    }
 
     startRead();
 }
 
 void
-CommandConnection::handleWrite(const boost::system::error_code& error)
+CommandConnection::handleWrite(boost::shared_ptr<std::string> /* text */,
+			       const boost::system::error_code& error)
 {
     if (error && error != boost::asio::error::operation_aborted) {
 	m_handler.stopConnection(shared_from_this());
@@ -150,6 +167,25 @@ CommandConnection::onIncomingMessage(const EmsMessage& message)
     }
 }
 
+void
+CommandConnection::onValuesChanged()
+{
+    if (m_parser.isWatching()) {
+	m_parser.onValuesChanged();
+	if (!m_parser.isWatching()) {
+	    m_watchTimer.cancel();
+	}
+    }
+}
+
+void
+CommandConnection::handleWatchTimeout(const boost::system::error_code& error)
+{
+    if (error != boost::asio::error::operation_aborted) {
+	m_parser.onWatchTimeout();
+    }
+}
+
 void
 CommandConnection::onTimeout()
 {
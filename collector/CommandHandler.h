@@ -56,13 +56,17 @@ class CommandConnection : public boost::enable_shared_from_this<CommandConnectio
 	}
 	void close() {
 	    m_socket.close();
+	    m_watchTimer.cancel();
 	}
 	void onIncomingMessage(const EmsMessage& message);
 	void onTimeout();
+	void onValuesChanged();
 
     private:
 	void handleRequest(const boost::system::error_code& error);
-	void handleWrite(const boost::system::error_code& error);
+	void handleWrite(boost::shared_ptr<std::string> text,
+			 const boost::system::error_code& error);
+	void handleWatchTimeout(const boost::system::error_code& error);
 
 	class CommandClient : public EmsCommandClient {
 	    public:
@@ -81,9 +85,11 @@ class CommandConnection : public boost::enable_shared_from_this<CommandConnectio
 	};
 
 	void respond(const std::string& response) {
-	    boost::asio::async_write(m_socket, boost::asio::buffer(response + "\n"),
+	    /* kept alive until written, as watch answers may come at any time */
+	    boost::shared_ptr<std::string> text(new std::string(response + "\n"));
+	    boost::asio::async_write(m_socket, boost::asio::buffer(*text),
 		boost::bind(&CommandConnection::handleWrite, shared_from_this(),
-			    boost::asio::placeholders::error));
+			    text, boost::asio::placeholders::error));
 	}
 
     private:
@@ -92,6 +98,7 @@ class CommandConnection : public boost::enable_shared_from_this<CommandConnectio
 	boost::shared_ptr<EmsCommandClient> m_commandClient;
 	ApiCommandParser m_parser;
 	CommandHandler& m_handler;
+	boost::asio::deadline_timer m_watchTimer;
 };
 
 class CommandHandler : private boost::noncopyable
@@ -107,6 +114,8 @@ class CommandHandler : private boost::noncopyable
     public:
 	void startConnection(CommandConnection::Ptr connection);
 	void stopConnection(CommandConnection::Ptr connection);
+	/* to be called after the cache handled the values */
+	void handleValues(const EmsValueBatch& values);
 
     private:
 	void handleAccept(CommandConnection::Ptr connection,
@@ -67,21 +67,21 @@ EmsCommandSender::sendMessage(const MessagePtr& message)
 
 	if (diff.total_milliseconds() <= MinDistanceBetweenRequests) {
 	    m_sendTimer.expires_at(timeIter->second + boost::posix_time::milliseconds(MinDistanceBetweenRequests));
-	    m_sendTimer.async_wait(boost::bind(&EmsCommandSender::doSendMessage, this, *message));
+	    m_sendTimer.async_wait(boost::bind(&EmsCommandSender::doSendMessage, this, message));
 	    scheduled = true;
 	}
     }
     if (!scheduled) {
-	doSendMessage(*message);
+	doSendMessage(message);
     }
 }
 
 void
-EmsCommandSender::doSendMessage(const EmsMessage& message)
+EmsCommandSender::doSendMessage(MessagePtr message)
 {
-    sendMessageImpl(message);
+    sendMessageImpl(*message);
     scheduleResponseTimeout();
-    m_lastCommTimes[message.getDestination()] = boost::posix_time::microsec_clock::universal_time();
+    m_lastCommTimes[message->getDestination()] = boost::posix_time::microsec_clock::universal_time();
 }
 
 void
@@ -58,7 +58,7 @@ class EmsCommandSender : public boost::noncopyable
 	void continueWithNextRequest();
 	void scheduleResponseTimeout();
 	void sendMessage(const MessagePtr& message);
-	void doSendMessage(const EmsMessage& message);
+	void doSendMessage(MessagePtr message);
 
     private:
 	static const unsigned int RequestTimeout = 1000; /* ms */
@@ -18,20 +18,37 @@
  */
 
 #include <iostream>
+#include <sstream>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
 #include "DataHandler.h"
-#include "ValueApi.h"
+#include "ValueMetadata.h"
 
 DataHandler::DataHandler(boost::asio::io_service& ios,
-			 boost::asio::ip::tcp::endpoint& endpoint) :
-    m_ios(ios),
-    m_acceptor(ios, endpoint)
+			 boost::asio::ip::tcp::endpoint& endpoint, ValueCache& cache) :
+    DataHandler(ios, cache)
 {
+    m_acceptor.reset(new boost::asio::ip::tcp::acceptor(ios, endpoint));
     startAccepting();
 }
 
+DataHandler::DataHandler(boost::asio::io_service& ios, ValueCache& cache) :
+    m_ios(ios),
+    m_cache(cache),
+    m_queueSize(Options::dataQueueSize()),
+    m_overflowPolicy(Options::dataOverflowPolicy()),
+    /* sequence numbers of a restarted collector must not match old ones;
+     * less than 2^20 values per second never catch up with this */
+    m_sequence((uint64_t) time(NULL) << 20),
+    m_replaySize(Options::dataReplaySize())
+{
+}
+
 DataHandler::~DataHandler()
 {
-    m_acceptor.close();
+    if (m_acceptor) {
+	m_acceptor->close();
+    }
     std::for_each(m_connections.begin(), m_connections.end(),
 		  boost::bind(&DataConnection::close, boost::placeholders::_1));
     m_connections.clear();
@@ -56,6 +73,12 @@ void
 DataHandler::startConnection(DataConnection::Ptr connection)
 {
     m_connections.insert(connection);
+    m_interest |= connection->interest();
+    if (connection->format() == DataConnection::Lines) {
+	connection->startRead();
+    } else if (connection->format() == DataConnection::Events) {
+	connection->startEventStream();
+    }
 }
 
 void
@@ -63,28 +86,98 @@ DataHandler::stopConnection(DataConnection::Ptr connection)
 {
     m_connections.erase(connection);
     connection->close();
+    updateInterest();
 }
 
 void
-DataHandler::handleValue(const EmsValue& value)
+DataHandler::updateInterest()
 {
-    std::for_each(m_connections.begin(), m_connections.end(),
-		  boost::bind(&DataConnection::handleValue, boost::placeholders::_1, value));
+    m_interest = EmsValueMask();
+    for (auto& connection : m_connections) {
+	m_interest |= connection->interest();
+    }
+}
+
+bool
+DataHandler::loggedValues(uint64_t since, SequencedValueList& values) const
+{
+    uint64_t first = m_sequence + 1 - m_log.size();
+    if (since > m_sequence || since + 1 < first) {
+	return false;
+    }
+
+    for (uint64_t sequence = since + 1; sequence <= m_sequence; sequence++) {
+	const LoggedValue& logged = m_log[sequence - first];
+	SequencedValue value = {
+	    sequence, boost::make_shared<ValueEnvelope>(logged.value, logged.timestamp)
+	};
+	values.push_back(value);
+    }
+    return true;
+}
+
+void
+DataHandler::handleValues(const EmsValueBatch& values)
+{
+    /* format once, no matter how many clients are connected */
+    for (size_t i = 0; i < values.size(); i++) {
+	const EmsValue& value = values.begin()[i];
+	/* values without name are never sent */
+	if (!*ValueMetadata::typeName(value.getType())) {
+	    continue;
+	}
+
+	/* even without clients, so resuming clients can't miss values */
+	uint64_t sequence = ++m_sequence;
+	if (m_replaySize != 0) {
+	    LoggedValue logged = { value, values.timestamp() };
+	    m_log.push_back(logged);
+	    if (m_log.size() > m_replaySize) {
+		m_log.pop_front();
+	    }
+	}
+
+	if (!m_connections.empty() && m_interest.test(value.getType(), value.getSubType())) {
+	    SequencedValue line = { sequence, ValueEnvelope::get(values, i) };
+	    m_lines.push_back(line);
+	}
+    }
+
+    if (!m_lines.empty()) {
+	/* connections may stop themselves while handling the lines */
+	auto iter = m_connections.begin();
+	while (iter != m_connections.end()) {
+	    DataConnection::Ptr connection = *iter++;
+	    connection->output(m_lines);
+	}
+	m_lines.clear();
+    }
 }
 
 void
 DataHandler::startAccepting()
 {
     DataConnection::Ptr connection(new DataConnection(m_ios, *this));
-    m_acceptor.async_accept(connection->socket(),
+    m_acceptor->async_accept(connection->socket(),
 		            boost::bind(&DataHandler::handleAccept, this,
 					connection, boost::asio::placeholders::error));
 }
 
 
-DataConnection::DataConnection(boost::asio::io_service& ios, DataHandler& handler) :
+DataConnection::DataConnection(boost::asio::io_service& ios, DataHandler& handler,
+			       Format format) :
     m_socket(ios),
-    m_handler(handler)
+    m_handler(handler),
+    m_format(format),
+    m_interest(EmsValueMask::all()),
+    m_subscribed(false),
+    /* event streams always carry IDs, for resuming them */
+    m_sequenced(format == Events),
+    m_queuedBytes(0),
+    m_writing(false),
+    m_conflateInterval(0),
+    m_conflateTimer(ios),
+    m_keepaliveTimer(ios)
 {
 }
 
@@ -92,29 +185,516 @@ DataConnection::~DataConnection()
 {
 }
 
+template<typename T> static bool
+parseUnsigned(const std::string& text, T& result)
+{
+    /* lexical_cast accepts negative numbers for unsigned types */
+    if (text.empty() || !isdigit(text[0])) {
+	return false;
+    }
+    try {
+	result = boost::lexical_cast<T>(text);
+	return true;
+    } catch (boost::bad_lexical_cast& e) {
+	return false;
+    }
+}
+
 void
-DataConnection::handleWrite(const boost::system::error_code& error)
+DataConnection::handleRequest(const boost::system::error_code& error)
 {
-    if (error && error != boost::asio::error::operation_aborted) {
-	m_handler.stopConnection(shared_from_this());
+    if (error) {
+	/* a client closing its sending side may still want to receive data */
+	if (error != boost::asio::error::eof && error != boost::asio::error::operation_aborted) {
+	    m_handler.stopConnection(shared_from_this());
+	}
+	return;
+    }
+
+    std::istream requestStream(&m_request);
+    std::string line, cmd;
+    std::getline(requestStream, line);
+
+    std::istringstream request(line);
+    std::vector<std::string> selector;
+    request >> cmd;
+    while (request) {
+	std::string token;
+	request >> token;
+	if (!token.empty()) {
+	    selector.push_back(token);
+	}
     }
+
+    if (cmd == "binary") {
+	/* optionally followed by a snapshot or resume command, so those
+	 * values are sent as records, too */
+	const char *error = selector.empty() ? NULL : startSequence(selector);
+	if (error) {
+	    respond(error);
+	} else {
+	    /* commands can't be answered in between the records */
+	    startBinary();
+	    return;
+	}
+    } else if (cmd == "subscribe") {
+	respond(subscribe(selector) ? "OK" : "ERRARGS");
+    } else if (cmd == "snapshot" || cmd == "resume") {
+	selector.insert(selector.begin(), cmd);
+	const char *error = startSequence(selector);
+	respond(error ? error : "OK " + boost::lexical_cast<std::string>(m_handler.sequence()));
+    } else if (cmd == "conflate") {
+	unsigned int seconds;
+	if (selector.size() == 1 && parseUnsigned(selector[0], seconds)) {
+	    setConflateInterval(seconds);
+	    respond("OK");
+	} else {
+	    respond("ERRARGS");
+	}
+    } else if (cmd == "help") {
+	respond("Available commands:\n"
+		"subscribe [<subtype>|none|*] [<type>|*]\n"
+		"conflate <seconds>\n"
+		"snapshot\n"
+		"resume <sequence>\n"
+		"binary [snapshot|resume <sequence>]\n"
+		"OK");
+    } else if (!cmd.empty()) {
+	respond("ERRCMD");
+    }
+
+    startRead();
 }
 
 void
-DataConnection::handleValue(const EmsValue& value)
+DataConnection::startEventStream()
 {
-    std::ostringstream stream;
-    std::string type = ValueApi::getTypeName(value.getType());
-    std::string subtype = ValueApi::getSubTypeName(value.getSubType());
+    startDiscard();
+    scheduleKeepalive();
+}
+
+void
+DataConnection::startDiscard()
+{
+    boost::asio::async_read(m_socket, m_request, boost::asio::transfer_at_least(1),
+	boost::bind(&DataConnection::handleDiscard, shared_from_this(),
+		    boost::asio::placeholders::error));
+}
 
-    if (type.empty()) {
+void
+DataConnection::handleDiscard(const boost::system::error_code& error)
+{
+    if (error) {
+	/* unlike for line connections, EOF means the client went away */
+	if (error != boost::asio::error::operation_aborted) {
+	    m_handler.stopConnection(shared_from_this());
+	}
+	return;
+    }
+
+    m_request.consume(m_request.size());
+    startDiscard();
+}
+
+void
+DataConnection::scheduleKeepalive()
+{
+    m_keepaliveTimer.expires_from_now(boost::posix_time::seconds(KeepaliveInterval));
+    m_keepaliveTimer.async_wait(boost::bind(&DataConnection::handleKeepaliveTimer,
+					    shared_from_this(), boost::asio::placeholders::error));
+}
+
+void
+DataConnection::handleKeepaliveTimer(const boost::system::error_code& error)
+{
+    /* the timer is cancelled when closing, but an expiry queued before
+     * that still arrives here */
+    if (error == boost::asio::error::operation_aborted || !m_socket.is_open()) {
 	return;
     }
 
-    if (!subtype.empty()) {
-	stream << subtype << " ";
+    /* an SSE comment, ignored by the client */
+    if (!m_writing && m_queue.empty()) {
+	sendText(":\n\n");
     }
-    stream << type << " " << ValueApi::formatValue(value);
+    scheduleKeepalive();
+}
 
-    output(stream.str());
+bool
+DataConnection::subscribe(const std::vector<std::string>& selector)
+{
+    EmsValueMask mask;
+    if (!ValueMetadata::selectValues(selector, mask)) {
+	return false;
+    }
+
+    /* the first subscription replaces the default of getting everything */
+    if (!m_subscribed) {
+	m_interest = EmsValueMask();
+	m_subscribed = true;
+    }
+    m_interest |= mask;
+    m_handler.updateInterest();
+    return true;
+}
+
+/* names of the ids used in binary records, followed by the record layout */
+static const std::string&
+binarySchema()
+{
+    static std::string schema;
+
+    if (schema.empty()) {
+	std::ostringstream stream;
+	for (size_t type = 0; type < EmsValue::TypeCount; type++) {
+	    const char *name = ValueMetadata::typeName((EmsValue::Type) type);
+	    if (*name) {
+		stream << "type " << type << " " << name << "\n";
+	    }
+	}
+	for (size_t subtype = 0; subtype < EmsValue::SubTypeCount; subtype++) {
+	    const char *name = ValueMetadata::subTypeName((EmsValue::SubType) subtype);
+	    if (*name) {
+		stream << "subtype " << subtype << " " << name << "\n";
+	    }
+	}
+	stream << "reading " << EmsValue::Numeric << " numeric\n";
+	stream << "reading " << EmsValue::Integer << " integer\n";
+	stream << "reading " << EmsValue::Boolean << " boolean\n";
+	stream << "reading " << EmsValue::Enumeration << " enumeration\n";
+	stream << "records " << ValueEnvelope::RecordSize << "\n";
+	schema = stream.str();
+    }
+
+    return schema;
+}
+
+void
+DataConnection::startBinary()
+{
+    std::deque<SequencedValue> queue;
+
+    /* queued values are written in the new format, if they have a record */
+    m_format = Binary;
+    m_queue.swap(queue);
+    m_queuedBytes = 0;
+    for (auto& value : queue) {
+	queueValue(value);
+    }
+    /* the sequence number precedes each record */
+    respond("OK\n" + binarySchema() + (m_sequenced ? "sequence 8\n" : "") + "BINARY");
+}
+
+const char *
+DataConnection::startSequence(const std::vector<std::string>& request)
+{
+    uint64_t since;
+
+    if (request.size() == 1 && request[0] == "snapshot") {
+	queueSnapshot();
+    } else if (request.size() == 2 && request[0] == "resume" && parseUnsigned(request[1], since)) {
+	if (!queueResume(since)) {
+	    return "ERRRANGE";
+	}
+    } else {
+	return "ERRARGS";
+    }
+
+    return NULL;
+}
+
+void
+DataConnection::queueSnapshot()
+{
+    ValueCache& cache = m_handler.cache();
+    uint64_t sequence = m_handler.sequence();
+
+    /* the snapshot includes everything queued so far */
+    discardQueue();
+    for (size_t type = 0; type < EmsValue::TypeCount; type++) {
+	for (size_t subtype = 0; subtype < EmsValue::SubTypeCount; subtype++) {
+	    time_t timestamp;
+	    const EmsValue *value = cache.getValue((EmsValue::Type) type,
+						   (EmsValue::SubType) subtype, &timestamp);
+	    if (!value || (m_subscribed && !m_interest.test(value->getType(), value->getSubType()))) {
+		continue;
+	    }
+	    SequencedValue snapshotValue = {
+		sequence, boost::make_shared<ValueEnvelope>(*value, timestamp)
+	    };
+	    queueValue(snapshotValue);
+	}
+    }
+    m_sequenced = true;
+}
+
+bool
+DataConnection::queueResume(uint64_t since)
+{
+    SequencedValueList values;
+    if (!m_handler.loggedValues(since, values)) {
+	return false;
+    }
+
+    discardQueue();
+    for (auto& value : values) {
+	if (!m_subscribed || m_interest.test(value.envelope->type(), value.envelope->subType())) {
+	    queueValue(value);
+	}
+    }
+    m_sequenced = true;
+    return true;
+}
+
+void
+DataConnection::discardQueue()
+{
+    m_queue.clear();
+    m_queuedBytes = 0;
+    for (auto index : m_conflatedPending) {
+	m_conflated[index].latest.envelope.reset();
+    }
+    m_conflatedPending.clear();
+}
+
+void
+DataConnection::queueValue(const SequencedValue& value)
+{
+    size_t size = text(value.envelope).size();
+
+    /* e.g. values without binary record */
+    if (size != 0) {
+	m_queue.push_back(value);
+	m_queuedBytes += size;
+    }
+}
+
+void
+DataConnection::appendPrefix(std::string& out, uint64_t sequence) const
+{
+    switch (m_format) {
+	case Events:
+	    out += "id: ";
+	    out += boost::lexical_cast<std::string>(sequence);
+	    out += '\n';
+	    break;
+	case Binary:
+	    for (int shift = 56; shift >= 0; shift -= 8) {
+		out += (char) (sequence >> shift);
+	    }
+	    break;
+	default:
+	    out += boost::lexical_cast<std::string>(sequence);
+	    out += ' ';
+	    break;
+    }
+}
+
+void
+DataConnection::respond(const std::string& response)
+{
+    sendText(response + "\n");
+}
+
+void
+DataConnection::sendText(const std::string& text)
+{
+    m_responses += text;
+    if (!m_writing) {
+	startWrite();
+    }
+}
+
+void
+DataConnection::setConflateInterval(unsigned int seconds)
+{
+    bool wasConflating = m_conflateInterval != 0;
+
+    m_conflateInterval = seconds;
+    if (seconds != 0 && !wasConflating) {
+	m_conflated.resize(EmsValue::TypeCount * EmsValue::SubTypeCount);
+	scheduleConflateFlush();
+    } else if (seconds == 0 && wasConflating) {
+	/* pass on what was collected so far */
+	m_conflateTimer.cancel();
+	flushConflatedValues();
+	std::vector<ConflatedValue>().swap(m_conflated);
+    }
+}
+
+void
+DataConnection::scheduleConflateFlush()
+{
+    m_conflateTimer.expires_from_now(boost::posix_time::seconds(m_conflateInterval));
+    m_conflateTimer.async_wait(boost::bind(&DataConnection::handleConflateTimer,
+					   shared_from_this(), boost::asio::placeholders::error));
+}
+
+void
+DataConnection::handleConflateTimer(const boost::system::error_code& error)
+{
+    /* the timer is cancelled when turning off conflation or closing,
+     * but an expiry queued before that still arrives here */
+    if (error == boost::asio::error::operation_aborted || m_conflateInterval == 0 ||
+	    !m_socket.is_open()) {
+	return;
+    }
+
+    if (flushConflatedValues()) {
+	scheduleConflateFlush();
+    }
+}
+
+bool
+DataConnection::flushConflatedValues()
+{
+    for (auto index : m_conflatedPending) {
+	ConflatedValue& value = m_conflated[index];
+	const ValueEnvelope::Ptr& latest = value.latest.envelope;
+	/* the record contains the timestamp, so compare the value only */
+	if (!value.sent || value.sent->value() != latest->value()) {
+	    queueValue(value.latest);
+	    value.sent = latest;
+	}
+	value.latest.envelope.reset();
+    }
+    m_conflatedPending.clear();
+
+    if (m_queuedBytes > m_handler.queueSize() && !handleOverflow()) {
+	return false;
+    }
+    if (!m_writing && !m_queue.empty()) {
+	startWrite();
+    }
+    return true;
+}
+
+void
+DataConnection::output(const SequencedValueList& values)
+{
+    for (auto& value : values) {
+	const ValueEnvelope::Ptr& envelope = value.envelope;
+	if (m_subscribed && !m_interest.test(envelope->type(), envelope->subType())) {
+	    continue;
+	}
+	/* only scalar values have a binary record */
+	if (m_format == Binary && envelope->record().empty()) {
+	    continue;
+	}
+	if (m_conflateInterval != 0) {
+	    size_t index = envelope->type() * EmsValue::SubTypeCount + envelope->subType();
+	    ConflatedValue& conflated = m_conflated[index];
+	    if (!conflated.latest.envelope) {
+		m_conflatedPending.push_back(index);
+	    }
+	    conflated.latest = value;
+	    continue;
+	}
+	m_queue.push_back(value);
+	m_queuedBytes += text(envelope).size();
+    }
+
+    if (m_queuedBytes > m_handler.queueSize() && !handleOverflow()) {
+	return;
+    }
+    if (!m_writing && !m_queue.empty()) {
+	startWrite();
+    }
+}
+
+void
+DataConnection::startWrite()
+{
+    /* coalesce everything queued so far into a single write */
+    m_writingLines.assign(m_queue.begin(), m_queue.end());
+    m_queue.clear();
+    m_queuedBytes = 0;
+    m_writingResponses.swap(m_responses);
+    m_responses.clear();
+
+    m_buffers.clear();
+    if (!m_writingResponses.empty()) {
+	m_buffers.push_back(boost::asio::buffer(m_writingResponses));
+    }
+    /* the buffers point into it, so it must not be reallocated */
+    m_writingPrefixes.clear();
+    if (m_sequenced) {
+	m_writingPrefixes.reserve(m_writingLines.size() * MaxPrefixLength);
+    }
+    for (auto& value : m_writingLines) {
+	if (m_sequenced) {
+	    size_t start = m_writingPrefixes.size();
+	    appendPrefix(m_writingPrefixes, value.sequence);
+	    m_buffers.push_back(boost::asio::buffer(m_writingPrefixes.data() + start,
+						    m_writingPrefixes.size() - start));
+	}
+	boost::string_ref line = text(value.envelope);
+	m_buffers.push_back(boost::asio::buffer(line.data(), line.size()));
+    }
+    m_writing = true;
+
+    boost::asio::async_write(m_socket, m_buffers,
+	boost::bind(&DataConnection::handleWrite, shared_from_this(),
+		    boost::asio::placeholders::error));
+}
+
+void
+DataConnection::handleWrite(const boost::system::error_code& error)
+{
+    if (error) {
+	if (error != boost::asio::error::operation_aborted) {
+	    m_handler.stopConnection(shared_from_this());
+	}
+	return;
+    }
+
+    m_writing = false;
+    m_writingLines.clear();
+    if (!m_queue.empty() || !m_responses.empty()) {
+	startWrite();
+    }
+}
+
+bool
+DataConnection::handleOverflow()
+{
+    switch (m_handler.overflowPolicy()) {
+	case Options::DataDisconnect:
+	    if (Options::ioDebug()) {
+		Options::ioDebug() << "DATA: closing connection of client not keeping up" << std::endl;
+	    }
+	    m_handler.stopConnection(shared_from_this());
+	    return false;
+	case Options::DataConflate:
+	    conflateQueue();
+	    break;
+	case Options::DataDropOldest:
+	    break;
+    }
+
+    /* also applies if conflating wasn't sufficient */
+    while (m_queuedBytes > m_handler.queueSize()) {
+	m_queuedBytes -= text(m_queue.front().envelope).size();
+	m_queue.pop_front();
+    }
+    return true;
+}
+
+void
+DataConnection::conflateQueue()
+{
+    /* keep only the latest queued line of each value */
+    EmsValueMask seen;
+    std::deque<SequencedValue> latest;
+
+    for (auto iter = m_queue.rbegin(); iter != m_queue.rend(); ++iter) {
+	const ValueEnvelope::Ptr& envelope = iter->envelope;
+	if (seen.test(envelope->type(), envelope->subType())) {
+	    m_queuedBytes -= text(envelope).size();
+	} else {
+	    seen.set(envelope->type(), envelope->subType());
+	    latest.push_front(*iter);
+	}
+    }
+    m_queue.swap(latest);
 }
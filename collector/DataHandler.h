@@ -20,24 +20,46 @@
 #ifndef __DATAHANDLER_H__
 #define __DATAHANDLER_H__
 
+#include <deque>
 #include <set>
 #include <boost/asio.hpp>
 #include <boost/bind/bind.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 #include "EmsMessage.h"
 #include "Noncopyable.h"
+#include "Options.h"
+#include "ValueCache.h"
+#include "ValueEnvelope.h"
 
 class DataHandler;
 
+/* a value of the data stream, with its position in it */
+struct SequencedValue {
+    uint64_t sequence;
+    ValueEnvelope::Ptr envelope;
+};
+typedef std::vector<SequencedValue> SequencedValueList;
+
 class DataConnection : public boost::enable_shared_from_this<DataConnection>,
 		       private boost::noncopyable
 {
     public:
 	typedef boost::shared_ptr<DataConnection> Ptr;
 
+	typedef enum {
+	    /* '[subtype ]type value' lines, accepting commands from the client */
+	    Lines,
+	    /* server-sent events of an HTTP response */
+	    Events,
+	    /* fixed size records, see ValueEnvelope, after a textual schema */
+	    Binary
+	} Format;
+
     public:
-	DataConnection(boost::asio::io_service& ios, DataHandler& handler);
+	DataConnection(boost::asio::io_service& ios, DataHandler& handler,
+		       Format format = Lines);
 	~DataConnection();
 
     public:
@@ -46,33 +68,139 @@ class DataConnection : public boost::enable_shared_from_this<DataConnection>,
 	}
 	void close() {
 	    m_socket.close();
+	    m_conflateTimer.cancel();
+	    m_keepaliveTimer.cancel();
+	}
+	void startRead() {
+	    boost::asio::async_read_until(m_socket, m_request, "\n",
+		boost::bind(&DataConnection::handleRequest, shared_from_this(),
+			    boost::asio::placeholders::error));
 	}
-	void handleValue(const EmsValue& value);
+	/* event streams only read for noticing the client going away */
+	void startEventStream();
+	Format format() const {
+	    return m_format;
+	}
+	/* values the client subscribed to, all if it didn't subscribe */
+	const EmsValueMask& interest() const {
+	    return m_interest;
+	}
+	/* adds the values matching a cache selector, false if it is invalid */
+	bool subscribe(const std::vector<std::string>& selector);
+	/* queues the subscribed values for writing */
+	void output(const SequencedValueList& values);
+	/* queue the current values or the ones after the given sequence number
+	 * ahead of the live values, and prefix all values with their sequence
+	 * number from now on; resume fails if the values aren't logged anymore.
+	 * Writing starts with the next text or values sent. */
+	void queueSnapshot();
+	bool queueResume(uint64_t since);
+	/* queues text to be written before any queued values */
+	void sendText(const std::string& text);
 
     private:
+	boost::string_ref text(const ValueEnvelope::Ptr& envelope) const {
+	    switch (m_format) {
+		case Events: return envelope->event();
+		case Binary: return envelope->record();
+		default: return envelope->dataLine();
+	    }
+	}
+	void handleRequest(const boost::system::error_code& error);
+	void startDiscard();
+	void handleDiscard(const boost::system::error_code& error);
+	void scheduleKeepalive();
+	void handleKeepaliveTimer(const boost::system::error_code& error);
+	void respond(const std::string& response);
+	/* 'snapshot' or 'resume <sequence>', returns the error response */
+	const char * startSequence(const std::vector<std::string>& request);
+	void startBinary();
+	void discardQueue();
+	void queueValue(const SequencedValue& value);
+	void appendPrefix(std::string& out, uint64_t sequence) const;
+	void setConflateInterval(unsigned int seconds);
+	void scheduleConflateFlush();
+	void handleConflateTimer(const boost::system::error_code& error);
+	/* false if the connection was closed */
+	bool flushConflatedValues();
+	void startWrite();
 	void handleWrite(const boost::system::error_code& error);
+	/* false if the connection was closed */
+	bool handleOverflow();
+	void conflateQueue();
 
-	void output(const std::string& text) {
-	    boost::asio::async_write(m_socket, boost::asio::buffer(text + "\n"),
-		boost::bind(&DataConnection::handleWrite, shared_from_this(),
-			    boost::asio::placeholders::error));
-	}
     private:
+	/* 'id: <20 digits>\n' */
+	static const size_t MaxPrefixLength = 25;
+	/* proxies and browsers drop event streams idle for too long */
+	static const unsigned int KeepaliveInterval = 30;
+
 	boost::asio::ip::tcp::socket m_socket;
 	DataHandler& m_handler;
+	Format m_format;
+	boost::asio::streambuf m_request;
+	EmsValueMask m_interest;
+	bool m_subscribed;
+	/* values are prefixed with their sequence number */
+	bool m_sequenced;
+	/* lines and responses waiting for the write in progress to finish */
+	std::deque<SequencedValue> m_queue;
+	size_t m_queuedBytes;
+	std::string m_responses;
+	/* the write in progress, kept alive until it finishes */
+	bool m_writing;
+	SequencedValueList m_writingLines;
+	std::string m_writingResponses;
+	std::string m_writingPrefixes;
+	std::vector<boost::asio::const_buffer> m_buffers;
+
+	/* in conflation mode, only the latest value of each sensor is sent,
+	 * every m_conflateInterval seconds and only if it changed */
+	struct ConflatedValue {
+	    SequencedValue latest;
+	    ValueEnvelope::Ptr sent;
+	};
+	unsigned int m_conflateInterval;
+	boost::asio::deadline_timer m_conflateTimer;
+	/* indexed by type and subtype, empty if conflation is off */
+	std::vector<ConflatedValue> m_conflated;
+	/* indices of the values received since the last flush */
+	std::vector<size_t> m_conflatedPending;
+
+	boost::asio::deadline_timer m_keepaliveTimer;
 };
 
 class DataHandler : private boost::noncopyable
 {
     public:
 	DataHandler(boost::asio::io_service& ios,
-		    boost::asio::ip::tcp::endpoint& endpoint);
+		    boost::asio::ip::tcp::endpoint& endpoint, ValueCache& cache);
+	/* without listening port, for connections accepted by other handlers */
+	DataHandler(boost::asio::io_service& ios, ValueCache& cache);
 	~DataHandler();
 
     public:
 	void startConnection(DataConnection::Ptr connection);
 	void stopConnection(DataConnection::Ptr connection);
-	void handleValue(const EmsValue& value);
+	void handleValues(const EmsValueBatch& values);
+	/* to be called when a connection changed its subscriptions */
+	void updateInterest();
+
+	size_t queueSize() const {
+	    return m_queueSize;
+	}
+	Options::DataOverflowPolicy overflowPolicy() const {
+	    return m_overflowPolicy;
+	}
+	ValueCache& cache() {
+	    return m_cache;
+	}
+	/* sequence number of the latest value */
+	uint64_t sequence() const {
+	    return m_sequence;
+	}
+	/* the values after the given sequence number, false if not all are logged */
+	bool loggedValues(uint64_t since, SequencedValueList& values) const;
 
     private:
 	void handleAccept(DataConnection::Ptr connection,
@@ -81,8 +209,24 @@ class DataHandler : private boost::noncopyable
 
     private:
 	boost::asio::io_service& m_ios;
-	boost::asio::ip::tcp::acceptor m_acceptor;
+	ValueCache& m_cache;
+	boost::scoped_ptr<boost::asio::ip::tcp::acceptor> m_acceptor;
 	std::set<DataConnection::Ptr> m_connections;
+	/* union of the subscriptions of all connections */
+	EmsValueMask m_interest;
+	size_t m_queueSize;
+	Options::DataOverflowPolicy m_overflowPolicy;
+	/* values of the batch being handled, shared by all connections */
+	SequencedValueList m_lines;
+	uint64_t m_sequence;
+	/* the latest m_replaySize values, the last one has m_sequence;
+	 * they are only formatted when replayed */
+	struct LoggedValue {
+	    EmsValue value;
+	    time_t timestamp;
+	};
+	std::deque<LoggedValue> m_log;
+	size_t m_replaySize;
 };
 
 #endif /* __DATAHANDLER_H__ */
@@ -320,87 +320,167 @@ Database::executeQuery(mysqlpp::Query& query)
     return false;
 }
 
-void
-Database::handleValue(const EmsValue& value)
+const Database::NumericMapping Database::NUMERICMAPPING[] = {
+    { EmsValue::SollTemp, EmsValue::Kessel, SensorKesselSollTemp },
+    { EmsValue::IstTemp, EmsValue::Kessel, SensorKesselIstTemp },
+    { EmsValue::SollTemp, EmsValue::WW, SensorWarmwasserSollTemp },
+    { EmsValue::IstTemp, EmsValue::WW, SensorWarmwasserIstTemp },
+    { EmsValue::SollTemp, EmsValue::HK1, SensorVorlaufHK1SollTemp },
+    { EmsValue::IstTemp, EmsValue::HK1, SensorVorlaufHK1IstTemp },
+    { EmsValue::SollTemp, EmsValue::HK2, SensorVorlaufHK2SollTemp },
+    { EmsValue::IstTemp, EmsValue::HK2, SensorVorlaufHK2IstTemp },
+    { EmsValue::IstTemp, EmsValue::Ruecklauf, SensorRuecklaufTemp },
+    { EmsValue::IstTemp, EmsValue::Aussen, SensorAussenTemp },
+    { EmsValue::GedaempfteTemp, EmsValue::Aussen, SensorGedaempfteAussenTemp },
+    { EmsValue::RaumSollTemp, EmsValue::HK1, SensorRaumSollTemp },
+    { EmsValue::RaumIstTemp, EmsValue::HK1, SensorRaumIstTemp },
+    { EmsValue::Flammenstrom, EmsValue::None, SensorFlammenstrom },
+    { EmsValue::Systemdruck, EmsValue::None, SensorSystemdruck },
+    { EmsValue::IstTemp, EmsValue::Waermetauscher, SensorWaermetauscherTemp },
+    { EmsValue::DurchflussMenge, EmsValue::WW, SensorWarmwasserDurchfluss },
+    { EmsValue::IstTemp, EmsValue::SolarSpeicher, SensorSolarSpeicherTemp },
+    { EmsValue::IstTemp, EmsValue::SolarKollektor, SensorSolarKollektorTemp }
+};
+
+const Database::NumericMapping Database::INTEGERMAPPING[] = {
+    { EmsValue::BetriebsZeit, EmsValue::Kessel, SensorBetriebszeit },
+    { EmsValue::HeizZeit, EmsValue::Kessel, SensorHeizZeit },
+    { EmsValue::Brennerstarts, EmsValue::Kessel, SensorBrennerstarts },
+    { EmsValue::WarmwasserbereitungsZeit, EmsValue::None, SensorWarmwasserbereitungsZeit },
+    { EmsValue::WarmwasserBereitungen, EmsValue::None, SensorWarmwasserBereitungen },
+    { EmsValue::Mischersteuerung, EmsValue::HK2, SensorMischersteuerung },
+    { EmsValue::IstModulation, EmsValue::Brenner, SensorMomLeistung },
+    { EmsValue::SollModulation, EmsValue::Brenner, SensorMaxLeistung },
+    { EmsValue::IstModulation, EmsValue::KesselPumpe, SensorPumpenModulation }
+};
+
+const Database::BooleanMapping Database::BOOLMAPPING[] = {
+    { EmsValue::FlammeAktiv, EmsValue::None, SensorFlamme },
+    { EmsValue::BrennerAktiv, EmsValue::None, SensorBrenner },
+    { EmsValue::ZuendungAktiv, EmsValue::None, SensorZuendung },
+    { EmsValue::PumpeAktiv, EmsValue::Kessel, SensorKesselPumpe },
+    { EmsValue::DreiWegeVentilAufWW, EmsValue::None, Sensor3WegeVentil },
+    { EmsValue::Tagbetrieb, EmsValue::HK1, SensorHK1Tagbetrieb },
+    { EmsValue::PumpeAktiv, EmsValue::HK1, SensorHK1Pumpe },
+    { EmsValue::Ferien, EmsValue::HK1, SensorHK1Ferien },
+    { EmsValue::Party, EmsValue::HK1, SensorHK1Party },
+    { EmsValue::Tagbetrieb, EmsValue::HK2, SensorHK2Tagbetrieb },
+    { EmsValue::PumpeAktiv, EmsValue::HK2, SensorHK2Pumpe },
+    { EmsValue::Ferien, EmsValue::HK2, SensorHK2Ferien },
+    { EmsValue::Party, EmsValue::HK2, SensorHK2Party },
+    { EmsValue::WarmwasserBereitung, EmsValue::None, SensorWarmwasserBereitung },
+    { EmsValue::WarmwasserTempOK, EmsValue::None, SensorWarmwasserTempOK },
+    { EmsValue::ZirkulationAktiv, EmsValue::None, SensorZirkulation },
+    { EmsValue::Tagbetrieb, EmsValue::Zirkulation, SensorZirkulationTagbetrieb },
+    { EmsValue::WWVorrang, EmsValue::None, SensorWWVorrang },
+    { EmsValue::Tagbetrieb, EmsValue::WW, SensorWWTagbetrieb },
+    { EmsValue::Sommerbetrieb, EmsValue::None, SensorSommerbetrieb },
+    { EmsValue::PumpeAktiv, EmsValue::Solar, SensorSolarPumpe }
+};
+
+const Database::StateMapping Database::STATEMAPPING[] = {
+    { EmsValue::FehlerCode, SensorFehlerCode },
+    { EmsValue::ServiceCode, SensorServiceCode }
+};
+
+EmsValueMask
+Database::interestMask()
 {
-    static const struct {
-	EmsValue::Type type;
-	EmsValue::SubType subtype;
-	NumericSensors sensor;
-    } NUMERICMAPPING[] = {
-	{ EmsValue::SollTemp, EmsValue::Kessel, SensorKesselSollTemp },
-	{ EmsValue::IstTemp, EmsValue::Kessel, SensorKesselIstTemp },
-	{ EmsValue::SollTemp, EmsValue::WW, SensorWarmwasserSollTemp },
-	{ EmsValue::IstTemp, EmsValue::WW, SensorWarmwasserIstTemp },
-	{ EmsValue::SollTemp, EmsValue::HK1, SensorVorlaufHK1SollTemp },
-	{ EmsValue::IstTemp, EmsValue::HK1, SensorVorlaufHK1IstTemp },
-	{ EmsValue::SollTemp, EmsValue::HK2, SensorVorlaufHK2SollTemp },
-	{ EmsValue::IstTemp, EmsValue::HK2, SensorVorlaufHK2IstTemp },
-	{ EmsValue::IstTemp, EmsValue::Ruecklauf, SensorRuecklaufTemp },
-	{ EmsValue::IstTemp, EmsValue::Aussen, SensorAussenTemp },
-	{ EmsValue::GedaempfteTemp, EmsValue::Aussen, SensorGedaempfteAussenTemp },
-	{ EmsValue::RaumSollTemp, EmsValue::HK1, SensorRaumSollTemp },
-	{ EmsValue::RaumIstTemp, EmsValue::HK1, SensorRaumIstTemp },
-	{ EmsValue::Flammenstrom, EmsValue::None, SensorFlammenstrom },
-	{ EmsValue::Systemdruck, EmsValue::None, SensorSystemdruck },
-	{ EmsValue::IstTemp, EmsValue::Waermetauscher, SensorWaermetauscherTemp },
-	{ EmsValue::DurchflussMenge, EmsValue::WW, SensorWarmwasserDurchfluss },
-	{ EmsValue::IstTemp, EmsValue::SolarSpeicher, SensorSolarSpeicherTemp },
-	{ EmsValue::IstTemp, EmsValue::SolarKollektor, SensorSolarKollektorTemp }
-    };
+    EmsValueMask mask;
 
-    static const struct {
-	EmsValue::Type type;
-	EmsValue::SubType subtype;
-	NumericSensors sensor;
-    } INTEGERMAPPING[] = {
-	{ EmsValue::BetriebsZeit, EmsValue::Kessel, SensorBetriebszeit },
-	{ EmsValue::HeizZeit, EmsValue::Kessel, SensorHeizZeit },
-	{ EmsValue::Brennerstarts, EmsValue::Kessel, SensorBrennerstarts },
-	{ EmsValue::WarmwasserbereitungsZeit, EmsValue::None, SensorWarmwasserbereitungsZeit },
-	{ EmsValue::WarmwasserBereitungen, EmsValue::None, SensorWarmwasserBereitungen },
-	{ EmsValue::Mischersteuerung, EmsValue::HK2, SensorMischersteuerung },
-	{ EmsValue::IstModulation, EmsValue::Brenner, SensorMomLeistung },
-	{ EmsValue::SollModulation, EmsValue::Brenner, SensorMaxLeistung },
-	{ EmsValue::IstModulation, EmsValue::KesselPumpe, SensorPumpenModulation }
-    };
+    for (auto& mapping : NUMERICMAPPING) {
+	mask.set(mapping.type, mapping.subtype);
+    }
+    for (auto& mapping : INTEGERMAPPING) {
+	mask.set(mapping.type, mapping.subtype);
+    }
+    for (auto& mapping : BOOLMAPPING) {
+	if (mapping.subtype == EmsValue::None) {
+	    mask.set(mapping.type);
+	} else {
+	    mask.set(mapping.type, mapping.subtype);
+	}
+    }
+    for (auto& mapping : STATEMAPPING) {
+	mask.set(mapping.type);
+    }
+    mask.set(EmsValue::Betriebsart, EmsValue::HK1);
+    mask.set(EmsValue::Betriebsart, EmsValue::HK2);
 
-    static const struct {
-	EmsValue::Type type;
-	EmsValue::SubType subtype;
-	BooleanSensors sensor;
-    } BOOLMAPPING[] = {
-	{ EmsValue::FlammeAktiv, EmsValue::None, SensorFlamme },
-	{ EmsValue::BrennerAktiv, EmsValue::None, SensorBrenner },
-	{ EmsValue::ZuendungAktiv, EmsValue::None, SensorZuendung },
-	{ EmsValue::PumpeAktiv, EmsValue::Kessel, SensorKesselPumpe },
-	{ EmsValue::DreiWegeVentilAufWW, EmsValue::None, Sensor3WegeVentil },
-	{ EmsValue::Tagbetrieb, EmsValue::HK1, SensorHK1Tagbetrieb },
-	{ EmsValue::PumpeAktiv, EmsValue::HK1, SensorHK1Pumpe },
-	{ EmsValue::Ferien, EmsValue::HK1, SensorHK1Ferien },
-	{ EmsValue::Party, EmsValue::HK1, SensorHK1Party },
-	{ EmsValue::Tagbetrieb, EmsValue::HK2, SensorHK2Tagbetrieb },
-	{ EmsValue::PumpeAktiv, EmsValue::HK2, SensorHK2Pumpe },
-	{ EmsValue::Ferien, EmsValue::HK2, SensorHK2Ferien },
-	{ EmsValue::Party, EmsValue::HK2, SensorHK2Party },
-	{ EmsValue::WarmwasserBereitung, EmsValue::None, SensorWarmwasserBereitung },
-	{ EmsValue::WarmwasserTempOK, EmsValue::None, SensorWarmwasserTempOK },
-	{ EmsValue::ZirkulationAktiv, EmsValue::None, SensorZirkulation },
-	{ EmsValue::Tagbetrieb, EmsValue::Zirkulation, SensorZirkulationTagbetrieb },
-	{ EmsValue::WWVorrang, EmsValue::None, SensorWWVorrang },
-	{ EmsValue::Tagbetrieb, EmsValue::WW, SensorWWTagbetrieb },
-	{ EmsValue::Sommerbetrieb, EmsValue::None, SensorSommerbetrieb },
-	{ EmsValue::PumpeAktiv, EmsValue::Solar, SensorSolarPumpe }
-    };
+    return mask;
+}
 
-    static const struct {
-	EmsValue::Type type;
-	StateSensors sensor;
-    } STATEMAPPING[] = {
-	{ EmsValue::FehlerCode, SensorFehlerCode },
-	{ EmsValue::ServiceCode, SensorServiceCode }
+std::vector<Database::SensorSlot>
+Database::buildSensorSlots()
+{
+    std::vector<SensorSlot> slots(EmsValue::TypeCount * EmsValue::SubTypeCount);
+    /* the first matching mapping wins */
+    auto add = [&slots] (EmsValue::Type type, EmsValue::SubType subtype,
+			 SensorSlot::Kind kind, unsigned int sensor) {
+	SensorSlot& slot = slots[type * EmsValue::SubTypeCount + subtype];
+	if (slot.kind == SensorSlot::Unmapped) {
+	    slot.kind = kind;
+	    slot.sensor = sensor;
+	}
     };
 
+    for (auto& mapping : NUMERICMAPPING) {
+	add(mapping.type, mapping.subtype, SensorSlot::Numeric, mapping.sensor);
+    }
+    for (auto& mapping : INTEGERMAPPING) {
+	add(mapping.type, mapping.subtype, SensorSlot::Integer, mapping.sensor);
+    }
+    for (auto& mapping : BOOLMAPPING) {
+	for (size_t subtype = 0; subtype < EmsValue::SubTypeCount; subtype++) {
+	    if (mapping.subtype == EmsValue::None || mapping.subtype == subtype) {
+		add(mapping.type, (EmsValue::SubType) subtype, SensorSlot::Boolean, mapping.sensor);
+	    }
+	}
+    }
+    for (auto& mapping : STATEMAPPING) {
+	for (size_t subtype = 0; subtype < EmsValue::SubTypeCount; subtype++) {
+	    add(mapping.type, (EmsValue::SubType) subtype, SensorSlot::State, mapping.sensor);
+	}
+    }
+
+    return slots;
+}
+
+void
+Database::handleValues(const EmsValueBatch& values)
+{
+    for (auto& value : values) {
+	handleValue(value, values.timestamp());
+    }
+
+    updateEndTimes(numericTableName, m_pendingNumericIds, values.timestamp());
+    updateEndTimes(booleanTableName, m_pendingBooleanIds, values.timestamp());
+    updateEndTimes(stateTableName, m_pendingStateIds, values.timestamp());
+}
+
+void
+Database::updateEndTimes(const char *table, std::vector<mysqlpp::ulonglong>& ids, time_t now)
+{
+    if (ids.empty()) {
+	return;
+    }
+
+    mysqlpp::Query query = m_connection->query();
+    mysqlpp::sql_datetime timestamp(now);
+
+    query << "update " << table << " set endtime ='" << timestamp << "' where id in (";
+    for (size_t i = 0; i < ids.size(); i++) {
+	query << (i > 0 ? "," : "") << ids[i];
+    }
+    query << ")";
+    executeQuery(query);
+
+    ids.clear();
+}
+
+void
+Database::handleValue(const EmsValue& value, time_t now)
+{
     if (!value.isValid()) {
 	return;
     }
@@ -408,43 +488,35 @@ Database::handleValue(const EmsValue& value)
     EmsValue::Type type = value.getType();
     EmsValue::SubType subtype = value.getSubType();
 
-    for (size_t i = 0; i < sizeof(NUMERICMAPPING) / sizeof(NUMERICMAPPING[0]); i++) {
-	if (type == NUMERICMAPPING[i].type && subtype == NUMERICMAPPING[i].subtype) {
-	    addSensorValue(NUMERICMAPPING[i].sensor, value.getValue<float>());
+    static const std::vector<SensorSlot> slots = buildSensorSlots();
+    const SensorSlot& slot = slots[type * EmsValue::SubTypeCount + subtype];
+
+    switch (slot.kind) {
+	case SensorSlot::Numeric:
+	    addSensorValue((NumericSensors) slot.sensor, value.getValue<float>(), now);
 	    return;
-	}
-    }
-    for (size_t i = 0; i < sizeof(INTEGERMAPPING) / sizeof(INTEGERMAPPING[0]); i++) {
-	if (type == INTEGERMAPPING[i].type && subtype == INTEGERMAPPING[i].subtype) {
-	    addSensorValue(INTEGERMAPPING[i].sensor, value.getValue<unsigned int>());
+	case SensorSlot::Integer:
+	    addSensorValue((NumericSensors) slot.sensor, value.getValue<unsigned int>(), now);
 	    return;
-	}
-    }
-    for (size_t i = 0; i < sizeof(BOOLMAPPING) / sizeof(BOOLMAPPING[0]); i++) {
-	if (type == BOOLMAPPING[i].type) {
-	    if (BOOLMAPPING[i].subtype == EmsValue::None || subtype == BOOLMAPPING[i].subtype) {
-		addSensorValue(BOOLMAPPING[i].sensor, value.getValue<bool>());
-		return;
-	    }
-	}
-    }
-    for (size_t i = 0; i < sizeof(STATEMAPPING) / sizeof(STATEMAPPING[0]); i++) {
-	if (type == STATEMAPPING[i].type) {
-	    addSensorValue(STATEMAPPING[i].sensor, value.getValue<std::string>());
+	case SensorSlot::Boolean:
+	    addSensorValue((BooleanSensors) slot.sensor, value.getValue<bool>(), now);
 	    return;
-	}
+	case SensorSlot::State:
+	    addSensorValue((StateSensors) slot.sensor, value.getValue<std::string>(), now);
+	    return;
+	case SensorSlot::Unmapped:
+	    break;
     }
 
     if (type == EmsValue::Betriebsart && (subtype == EmsValue::HK1 || subtype == EmsValue::HK2)) {
 	BooleanSensors sensor = subtype == EmsValue::HK2 ? SensorHK2Automatik : SensorHK1Automatik;
-	addSensorValue(sensor, value.getValue<uint8_t>() == 2);
+	addSensorValue(sensor, value.getValue<uint8_t>() == 2, now);
     }
 }
 
 void
-Database::addSensorValue(NumericSensors sensor, float value)
+Database::addSensorValue(NumericSensors sensor, float value, time_t now)
 {
-    time_t now = time(NULL);
     if (!m_connection || !checkAndUpdateRateLimit(sensor, now)) {
 	return;
     }
@@ -457,9 +529,7 @@ Database::addSensorValue(NumericSensors sensor, float value)
     mysqlpp::sql_datetime timestamp(now);
 
     if (idValid) {
-	query << "update " << numericTableName << " set endtime ='" << timestamp
-	      << "' where id = " << idIter->second;
-	executeQuery(query);
+	m_pendingNumericIds.push_back(idIter->second);
     }
 
     if (valueChanged || !idValid) {
@@ -473,9 +543,8 @@ Database::addSensorValue(NumericSensors sensor, float value)
 }
 
 void
-Database::addSensorValue(BooleanSensors sensor, bool value)
+Database::addSensorValue(BooleanSensors sensor, bool value, time_t now)
 {
-    time_t now = time(NULL);
     if (!m_connection) {
 	return;
     }
@@ -488,9 +557,7 @@ Database::addSensorValue(BooleanSensors sensor, bool value)
     mysqlpp::sql_datetime timestamp(now);
 
     if (idValid) {
-	query << "update " << booleanTableName << " set endtime ='" << timestamp
-	      << "' where id = " << idIter->second;
-	executeQuery(query);
+	m_pendingBooleanIds.push_back(idIter->second);
     }
 
     if (valueChanged || !idValid) {
@@ -504,9 +571,8 @@ Database::addSensorValue(BooleanSensors sensor, bool value)
 }
 
 void
-Database::addSensorValue(StateSensors sensor, const std::string& value)
+Database::addSensorValue(StateSensors sensor, const std::string& value, time_t now)
 {
-    time_t now = time(NULL);
     if (!m_connection) {
 	return;
     }
@@ -519,9 +585,7 @@ Database::addSensorValue(StateSensors sensor, const std::string& value)
     mysqlpp::sql_datetime timestamp(now);
 
     if (idValid) {
-	query << "update " << stateTableName << " set endtime ='" << timestamp
-	      << "' where id = " << idIter->second;
-	executeQuery(query);
+	m_pendingStateIds.push_back(idIter->second);
     }
 
     if (valueChanged || !idValid) {
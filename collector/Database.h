@@ -22,6 +22,7 @@
 
 #include <map>
 #include <queue>
+#include <vector>
 #include <mysql++/connection.h>
 #include <mysql++/query.h>
 #include "EmsMessage.h"
@@ -33,7 +34,8 @@ class Database {
 
     public:
 	bool connect(const std::string& server, const std::string& user, const std::string& password);
-	void handleValue(const EmsValue& value);
+	void handleValues(const EmsValueBatch& values);
+	static EmsValueMask interestMask();
 
     private:
 	typedef enum {
@@ -103,9 +105,39 @@ class Database {
 	    StateSensorLast = 202
 	} StateSensors;
 
-	void addSensorValue(NumericSensors sensor, float value);
-	void addSensorValue(BooleanSensors sensor, bool value);
-	void addSensorValue(StateSensors sensor, const std::string& value);
+	struct NumericMapping {
+	    EmsValue::Type type;
+	    EmsValue::SubType subtype;
+	    NumericSensors sensor;
+	};
+	struct BooleanMapping {
+	    EmsValue::Type type;
+	    /* None matches all subtypes */
+	    EmsValue::SubType subtype;
+	    BooleanSensors sensor;
+	};
+	struct StateMapping {
+	    EmsValue::Type type;
+	    StateSensors sensor;
+	};
+
+	static const NumericMapping NUMERICMAPPING[];
+	static const NumericMapping INTEGERMAPPING[];
+	static const BooleanMapping BOOLMAPPING[];
+	static const StateMapping STATEMAPPING[];
+
+	/* the above tables, indexed by type * EmsValue::SubTypeCount + subtype */
+	struct SensorSlot {
+	    enum Kind { Unmapped, Numeric, Integer, Boolean, State } kind;
+	    unsigned int sensor;
+	};
+	static std::vector<SensorSlot> buildSensorSlots();
+
+	void handleValue(const EmsValue& value, time_t now);
+	void addSensorValue(NumericSensors sensor, float value, time_t now);
+	void addSensorValue(BooleanSensors sensor, bool value, time_t now);
+	void addSensorValue(StateSensors sensor, const std::string& value, time_t now);
+	void updateEndTimes(const char *table, std::vector<mysqlpp::ulonglong>& ids, time_t now);
 
     private:
 	bool createTables();
@@ -137,6 +169,10 @@ class Database {
 	std::map<unsigned int, bool> m_booleanCache;
 	std::map<unsigned int, std::string> m_stateCache;
 	std::map<unsigned int, mysqlpp::ulonglong> m_lastInsertIds;
+	/* rows whose end time is updated once per value batch */
+	std::vector<mysqlpp::ulonglong> m_pendingNumericIds;
+	std::vector<mysqlpp::ulonglong> m_pendingBooleanIds;
+	std::vector<mysqlpp::ulonglong> m_pendingStateIds;
 	mysqlpp::Connection *m_connection;
 };
 
@@ -17,8 +17,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstdio>
 #include <iostream>
-#include <sstream>
 #include <iomanip>
 #include <cmath>
 #include <boost/format.hpp>
@@ -36,8 +36,9 @@ EmsValue::EmsValue(Type type, SubType subType, const uint8_t *data,
 		   const std::vector<const uint8_t *> *invalidValues) :
     m_type(type),
     m_subType(subType),
-    m_readingType(Numeric),
-    m_isValid(true)
+    m_readingType(divider == 0 ? Integer : Numeric),
+    m_isValid(true),
+    m_divider(divider)
 {
     int value = 0;
     for (size_t i = 0; i < len; i++) {
@@ -70,94 +71,140 @@ EmsValue::EmsValue(Type type, SubType subType, const uint8_t *data,
 	}
     }
 
-    if (divider == 0) {
-	m_value = (unsigned int) value;
-	m_readingType = Integer;
-    } else {
-	m_value = (float) value / (float) divider;
-    }
+    m_value.raw = value;
 }
 
 EmsValue::EmsValue(Type type, SubType subType, uint8_t value, uint8_t bit) :
     m_type(type),
     m_subType(subType),
     m_readingType(Boolean),
-    m_value((value & (1 << bit)) != 0),
-    m_isValid(true)
+    m_isValid(true),
+    m_divider(0)
 {
+    m_value.boolean = (value & (1 << bit)) != 0;
 }
 
 EmsValue::EmsValue(Type type, SubType subType, uint8_t low, uint8_t medium, uint8_t high) :
     m_type(type),
     m_subType(subType),
     m_readingType(Kennlinie),
-    m_value(std::vector<uint8_t>({ low, medium, high })),
-    m_isValid(true)
+    m_isValid(true),
+    m_divider(0)
 {
+    m_value.kennlinie[0] = low;
+    m_value.kennlinie[1] = medium;
+    m_value.kennlinie[2] = high;
 }
 
 EmsValue::EmsValue(Type type, SubType subType, uint8_t value) :
     m_type(type),
     m_subType(subType),
     m_readingType(Enumeration),
-    m_value(value),
-    m_isValid(true)
+    m_isValid(true),
+    m_divider(0)
 {
+    m_value.enumeration = value;
 }
 
 EmsValue::EmsValue(Type type, SubType subType, const ErrorEntry& error) :
     m_type(type),
     m_subType(subType),
     m_readingType(Error),
-    m_value(error),
-    m_isValid(true)
+    m_isValid(true),
+    m_divider(0)
 {
+    m_value.error = error;
 }
 
 EmsValue::EmsValue(Type type, SubType subType, const EmsProto::DateRecord& record) :
     m_type(type),
     m_subType(subType),
     m_readingType(Date),
-    m_value(record),
-    m_isValid(true)
+    m_isValid(true),
+    m_divider(0)
 {
+    m_value.date = record;
 }
 
 EmsValue::EmsValue(Type type, SubType subType, const EmsProto::SystemTimeRecord& record) :
     m_type(type),
     m_subType(subType),
     m_readingType(SystemTime),
-    m_value(record),
-    m_isValid(true)
+    m_isValid(true),
+    m_divider(0)
 {
+    m_value.systemTime = record;
 }
 
-EmsValue::EmsValue(Type type, SubType subType, const std::string& value) :
+EmsValue::EmsValue(Type type, SubType subType, const char *value) :
     m_type(type),
     m_subType(subType),
     m_readingType(Formatted),
-    m_value(value),
-    m_isValid(true)
+    m_isValid(true),
+    m_divider(0)
 {
+    strncpy(m_value.text, value, MaxTextLength);
+    m_value.text[MaxTextLength] = 0;
 }
 
-EmsMessage::EmsMessage(ValueHandler& valueHandler, CacheAccessor cacheAccessor,
-		       const std::vector<uint8_t>& data) :
-    m_valueHandler(valueHandler),
-    m_cacheAccessor(cacheAccessor),
-    m_data(data)
+bool
+EmsValue::operator==(const EmsValue& other) const
 {
-    if (m_data.size() >= 4) {
-	m_source = m_data[0];
-	m_dest = m_data[1];
-	m_type = m_data[2];
-	m_offset = m_data[3];
-	m_data.erase(m_data.begin(), m_data.begin() + 4);
+    if (m_type != other.m_type || m_subType != other.m_subType ||
+	    m_readingType != other.m_readingType || m_isValid != other.m_isValid) {
+	return false;
+    }
+
+    switch (m_readingType) {
+	case Numeric:
+	case Integer:
+	    return m_value.raw == other.m_value.raw && m_divider == other.m_divider;
+	case Boolean:
+	    return m_value.boolean == other.m_value.boolean;
+	case Enumeration:
+	    return m_value.enumeration == other.m_value.enumeration;
+	case Kennlinie:
+	    return memcmp(m_value.kennlinie, other.m_value.kennlinie, sizeof(m_value.kennlinie)) == 0;
+	case Error:
+	    return m_value.error.type == other.m_value.error.type &&
+		    m_value.error.index == other.m_value.error.index &&
+		    memcmp(&m_value.error.record, &other.m_value.error.record,
+			   sizeof(m_value.error.record)) == 0;
+	case Date:
+	    return memcmp(&m_value.date, &other.m_value.date, sizeof(m_value.date)) == 0;
+	case SystemTime:
+	    return memcmp(&m_value.systemTime, &other.m_value.systemTime,
+			  sizeof(m_value.systemTime)) == 0;
+	case Formatted:
+	    return strcmp(m_value.text, other.m_value.text) == 0;
+    }
+
+    return false;
+}
+
+EmsMessage::EmsMessage(ValueBuffer& values, CacheAccessor cacheAccessor,
+		       const uint8_t *data, size_t length, PayloadShadow *shadow,
+		       const EmsValueMask *mask) :
+    m_values(&values),
+    m_cacheAccessor(cacheAccessor),
+    m_shadow(shadow),
+    m_shadowEntry(NULL),
+    m_mask(mask)
+{
+    if (length >= 4) {
+	m_source = data[0];
+	m_dest = data[1];
+	m_type = data[2];
+	m_offset = data[3];
+	m_data = data + 4;
+	m_length = length - 4;
     } else {
 	m_source = 0;
 	m_dest = 0;
 	m_type = 0;
 	m_offset = 0;
+	m_data = NULL;
+	m_length = 0;
     }
 }
 
@@ -171,8 +218,13 @@ EmsMessage::EmsMessage(uint8_t dest, uint8_t source,
 		       uint8_t type, uint8_t offset,
 		       const std::vector<uint8_t>& data,
 		       bool expectResponse) :
-    m_valueHandler(),
-    m_data(data),
+    m_values(NULL),
+    m_shadow(NULL),
+    m_shadowEntry(NULL),
+    m_mask(NULL),
+    m_sendData(data),
+    m_data(m_sendData.data()),
+    m_length(m_sendData.size()),
     m_source(source),
     m_dest(dest | (expectResponse ? 0x80 : 0)),
     m_type(type),
@@ -191,15 +243,401 @@ EmsMessage::getSendData(bool omitSenderAddress) const
     data.push_back(m_dest);
     data.push_back(m_type);
     data.push_back(m_offset);
-    data.insert(data.end(), m_data.begin(), m_data.end());
+    data.insert(data.end(), m_data, m_data + m_length);
 
     return data;
 }
 
+/*
+ * Field layout tables
+ *
+ * Every handled message is described by a table of the fields it contains,
+ * see BINDINGS below for the mapping of (source, type) to those tables.
+ * Fields which can't be expressed as table entries (because they depend
+ * on multiple bytes, on other values or on configuration) are handled by
+ * per-message parser functions running before or after the table.
+ */
+
+enum {
+    NumericField,
+    BooleanField,
+    EnumField,
+    KennlinieField,
+    DateField,
+    SystemTimeField
+};
+
+enum {
+    FieldUnsigned = 0,
+    FieldSigned = 1 << 0,
+    /* 0x7d00 and 0x8300 mark unavailable sensors */
+    FieldTemperature = 1 << 1
+};
+
+/* use the subtype the message was received for (e.g. HK1..HK4) */
+static const uint8_t MessageSubType = 0xff;
+
+struct EmsMessage::FieldDescriptor {
+    uint8_t offset;
+    uint8_t size;
+    uint8_t kind;
+    uint8_t flags;
+    /* divider (0 = integer) for numeric fields, bit for boolean ones */
+    uint8_t param;
+    uint8_t subtype;
+    EmsValue::Type type;
+};
+
+static constexpr EmsMessage::FieldDescriptor
+numericField(uint8_t offset, uint8_t size, uint8_t divider,
+	     EmsValue::Type type, uint8_t subtype, uint8_t flags = FieldSigned)
+{
+    return { offset, size, NumericField, flags, divider, subtype, type };
+}
+
+static constexpr EmsMessage::FieldDescriptor
+integerField(uint8_t offset, uint8_t size, EmsValue::Type type, uint8_t subtype)
+{
+    return { offset, size, NumericField, FieldUnsigned, 0, subtype, type };
+}
+
+static constexpr EmsMessage::FieldDescriptor
+temperatureField(uint8_t offset, EmsValue::Type type, uint8_t subtype)
+{
+    return { offset, 2, NumericField, FieldSigned | FieldTemperature, 10, subtype, type };
+}
+
+static constexpr EmsMessage::FieldDescriptor
+boolField(uint8_t offset, uint8_t bit, EmsValue::Type type, uint8_t subtype)
+{
+    return { offset, 1, BooleanField, 0, bit, subtype, type };
+}
+
+static constexpr EmsMessage::FieldDescriptor
+enumField(uint8_t offset, EmsValue::Type type, uint8_t subtype)
+{
+    return { offset, 1, EnumField, 0, 0, subtype, type };
+}
+
+static constexpr EmsMessage::FieldDescriptor
+recordField(uint8_t offset, uint8_t kind, uint8_t size, EmsValue::Type type, uint8_t subtype)
+{
+    return { offset, size, kind, 0, 0, subtype, type };
+}
+
+static constexpr EmsMessage::FieldDescriptor UBA_TOTAL_UPTIME_FIELDS[] = {
+    integerField(0, 3, EmsValue::BetriebsZeit, EmsValue::None)
+};
+
+static constexpr EmsMessage::FieldDescriptor UBA_MAINTENANCE_SETTINGS_FIELDS[] = {
+    enumField(0, EmsValue::Wartungsmeldungen, EmsValue::Kessel),
+    integerField(1, 1, EmsValue::HektoStundenVorWartung, EmsValue::Kessel),
+    recordField(2, DateField, sizeof(EmsProto::DateRecord), EmsValue::Wartungstermin, EmsValue::Kessel)
+};
+
+static constexpr EmsMessage::FieldDescriptor UBA_PARAMETERS_FIELDS[] = {
+    boolField(0, 1, EmsValue::KesselSchalter, EmsValue::Kessel),
+    numericField(1, 1, 1, EmsValue::SetTemp, EmsValue::Kessel),
+    integerField(2, 1, EmsValue::MaxModulation, EmsValue::Brenner),
+    integerField(3, 1, EmsValue::MinModulation, EmsValue::Brenner),
+    numericField(4, 1, 1, EmsValue::AusschaltHysterese, EmsValue::Kessel),
+    numericField(5, 1, 1, EmsValue::EinschaltHysterese, EmsValue::Kessel),
+    integerField(6, 1, EmsValue::AntipendelZeit, EmsValue::None),
+    integerField(8, 1, EmsValue::NachlaufZeit, EmsValue::KesselPumpe),
+    integerField(9, 1, EmsValue::MaxModulation, EmsValue::KesselPumpe),
+    integerField(10, 1, EmsValue::MinModulation, EmsValue::KesselPumpe)
+};
+
+static constexpr EmsMessage::FieldDescriptor UBA_MONITOR_FAST_FIELDS[] = {
+    numericField(0, 1, 1, EmsValue::SollTemp, EmsValue::Kessel),
+    temperatureField(1, EmsValue::IstTemp, EmsValue::Kessel),
+    integerField(3, 1, EmsValue::SollModulation, EmsValue::Brenner),
+    integerField(4, 1, EmsValue::IstModulation, EmsValue::Brenner),
+    boolField(7, 0, EmsValue::FlammeAktiv, EmsValue::None),
+    boolField(7, 2, EmsValue::BrennerAktiv, EmsValue::None),
+    boolField(7, 3, EmsValue::ZuendungAktiv, EmsValue::None),
+    boolField(7, 5, EmsValue::PumpeAktiv, EmsValue::Kessel),
+    boolField(7, 6, EmsValue::DreiWegeVentilAufWW, EmsValue::None),
+    boolField(7, 7, EmsValue::ZirkulationAktiv, EmsValue::None),
+    temperatureField(13, EmsValue::IstTemp, EmsValue::Ruecklauf),
+    numericField(15, 2, 10, EmsValue::Flammenstrom, EmsValue::None),
+    numericField(17, 1, 10, EmsValue::Systemdruck, EmsValue::None, FieldUnsigned),
+    temperatureField(25, EmsValue::IstTemp, EmsValue::Ansaugluft)
+};
+
+static constexpr EmsMessage::FieldDescriptor UBA_MONITOR_SLOW_FIELDS[] = {
+    temperatureField(0, EmsValue::IstTemp, EmsValue::Aussen),
+    temperatureField(2, EmsValue::IstTemp, EmsValue::Waermetauscher),
+    temperatureField(4, EmsValue::IstTemp, EmsValue::Abgas),
+    integerField(9, 1, EmsValue::IstModulation, EmsValue::KesselPumpe),
+    integerField(10, 3, EmsValue::Brennerstarts, EmsValue::Kessel),
+    integerField(13, 3, EmsValue::BetriebsZeit, EmsValue::Kessel),
+    integerField(16, 3, EmsValue::BetriebsZeit2, EmsValue::Kessel),
+    integerField(19, 3, EmsValue::HeizZeit, EmsValue::Kessel)
+};
+
+static constexpr EmsMessage::FieldDescriptor UBA_MAINTENANCE_STATUS_FIELDS[] = {
+    enumField(5, EmsValue::WartungFaellig, EmsValue::Kessel)
+};
+
+static constexpr EmsMessage::FieldDescriptor UBA_PARAMETER_WW_FIELDS[] = {
+    boolField(1, 0, EmsValue::KesselSchalter, EmsValue::WW),
+    numericField(2, 1, 1, EmsValue::SetTemp, EmsValue::WW),
+    enumField(7, EmsValue::Schaltpunkte, EmsValue::Zirkulation),
+    numericField(8, 1, 1, EmsValue::DesinfektionsTemp, EmsValue::WW)
+};
+
+static constexpr EmsMessage::FieldDescriptor UBA_MONITOR_WW_FIELDS[] = {
+    numericField(0, 1, 1, EmsValue::SollTemp, EmsValue::WW),
+    temperatureField(1, EmsValue::IstTemp, EmsValue::WW),
+    boolField(5, 0, EmsValue::Tagbetrieb, EmsValue::WW),
+    boolField(5, 1, EmsValue::EinmalLadungAktiv, EmsValue::WW),
+    boolField(5, 2, EmsValue::DesinfektionAktiv, EmsValue::WW),
+    boolField(5, 3, EmsValue::WarmwasserBereitung, EmsValue::None),
+    boolField(5, 4, EmsValue::NachladungAktiv, EmsValue::WW),
+    boolField(5, 5, EmsValue::WarmwasserTempOK, EmsValue::None),
+    boolField(6, 0, EmsValue::Fuehler1Defekt, EmsValue::WW),
+    boolField(6, 1, EmsValue::Fuehler2Defekt, EmsValue::WW),
+    boolField(6, 2, EmsValue::Stoerung, EmsValue::WW),
+    boolField(6, 3, EmsValue::StoerungDesinfektion, EmsValue::WW),
+    boolField(7, 0, EmsValue::Tagbetrieb, EmsValue::Zirkulation),
+    boolField(7, 2, EmsValue::ZirkulationAktiv, EmsValue::None),
+    boolField(7, 3, EmsValue::Ladevorgang, EmsValue::WW),
+    enumField(8, EmsValue::WWSystemType, EmsValue::None),
+    numericField(9, 1, 10, EmsValue::DurchflussMenge, EmsValue::WW, FieldUnsigned),
+    integerField(10, 3, EmsValue::WarmwasserbereitungsZeit, EmsValue::None),
+    integerField(13, 3, EmsValue::WarmwasserBereitungen, EmsValue::None)
+};
+
+static constexpr EmsMessage::FieldDescriptor RC_TIME_FIELDS[] = {
+    recordField(0, SystemTimeField, sizeof(EmsProto::SystemTimeRecord), EmsValue::SystemZeit, EmsValue::None)
+};
+
+static constexpr EmsMessage::FieldDescriptor RC_WW_OPMODE_FIELDS[] = {
+    boolField(0, 1, EmsValue::EigenesProgrammAktiv, EmsValue::WW),
+    boolField(1, 1, EmsValue::EigenesProgrammAktiv, EmsValue::Zirkulation),
+    enumField(2, EmsValue::Betriebsart, EmsValue::WW),
+    enumField(3, EmsValue::Betriebsart, EmsValue::Zirkulation),
+    boolField(4, 1, EmsValue::Desinfektion, EmsValue::WW),
+    enumField(5, EmsValue::DesinfektionTag, EmsValue::WW),
+    integerField(6, 1, EmsValue::DesinfektionStunde, EmsValue::WW),
+    numericField(8, 1, 1, EmsValue::MaxTemp, EmsValue::WW),
+    boolField(9, 1, EmsValue::EinmalLadungsLED, EmsValue::WW)
+};
+
+static constexpr EmsMessage::FieldDescriptor RC_SYSTEM_PARAMETER_FIELDS[] = {
+    numericField(5, 1, 1, EmsValue::MinTemp, EmsValue::RC),
+    enumField(6, EmsValue::GebaeudeArt, EmsValue::RC),
+    boolField(21, 1, EmsValue::ATDaempfung, EmsValue::RC)
+};
+
+static constexpr EmsMessage::FieldDescriptor RC_OUTDOOR_TEMP_FIELDS[] = {
+    numericField(0, 1, 1, EmsValue::GedaempfteTemp, EmsValue::Aussen)
+};
+
+/* MaxTemp and AuslegungsTemp depend on the heating system, see parseRCHKSystemFields() */
+static constexpr EmsMessage::FieldDescriptor RC_HK_OPMODE_FIELDS[] = {
+    numericField(1, 1, 2, EmsValue::NachtTemp, MessageSubType),
+    numericField(2, 1, 2, EmsValue::TagTemp, MessageSubType),
+    numericField(3, 1, 2, EmsValue::UrlaubTemp, MessageSubType),
+    numericField(4, 1, 2, EmsValue::RaumEinfluss, MessageSubType),
+    numericField(6, 1, 2, EmsValue::RaumOffset, MessageSubType),
+    enumField(7, EmsValue::Betriebsart, MessageSubType),
+    boolField(8, 0, EmsValue::Estrichtrocknung, MessageSubType),
+    numericField(16, 1, 1, EmsValue::MinTemp, MessageSubType),
+    boolField(19, 1, EmsValue::SchaltzeitOptimierung, MessageSubType),
+    numericField(22, 1, 1, EmsValue::SchwelleSommerWinter, MessageSubType),
+    numericField(23, 1, 1, EmsValue::FrostSchutzTemp, MessageSubType),
+    enumField(25, EmsValue::AbsenkModus, MessageSubType),
+    enumField(26, EmsValue::FBTyp, MessageSubType),
+    enumField(28, EmsValue::Frostschutz, MessageSubType),
+    numericField(37, 1, 2, EmsValue::RaumUebersteuerTemp, MessageSubType),
+    numericField(38, 1, 1, EmsValue::AbsenkungsAbbruchTemp, MessageSubType),
+    numericField(39, 1, 1, EmsValue::AbsenkungsSchwellenTemp, MessageSubType),
+    numericField(40, 1, 1, EmsValue::UrlaubAbsenkungsSchwellenTemp, MessageSubType),
+    enumField(41, EmsValue::UrlaubAbsenkungsArt, MessageSubType)
+};
+
+static constexpr EmsMessage::FieldDescriptor RC_HK_MONITOR_FIELDS[] = {
+    boolField(0, 0, EmsValue::Ausschaltoptimierung, MessageSubType),
+    boolField(0, 1, EmsValue::Einschaltoptimierung, MessageSubType),
+    boolField(0, 3, EmsValue::WWVorrang, MessageSubType),
+    boolField(0, 4, EmsValue::Estrichtrocknung, MessageSubType),
+    boolField(0, 6, EmsValue::Frostschutzbetrieb, MessageSubType),
+    boolField(1, 0, EmsValue::Sommerbetrieb, MessageSubType),
+    boolField(1, 1, EmsValue::Tagbetrieb, MessageSubType),
+    numericField(2, 1, 2, EmsValue::RaumSollTemp, MessageSubType),
+    temperatureField(3, EmsValue::RaumIstTemp, MessageSubType),
+    integerField(5, 1, EmsValue::EinschaltoptimierungsZeit, MessageSubType),
+    integerField(6, 1, EmsValue::AusschaltoptimierungsZeit, MessageSubType),
+    recordField(7, KennlinieField, 3, EmsValue::HKKennlinie, MessageSubType),
+    numericField(12, 1, 1, EmsValue::SollLeistung, MessageSubType),
+    boolField(13, 2, EmsValue::Party, MessageSubType),
+    boolField(13, 3, EmsValue::Pause, MessageSubType),
+    boolField(13, 6, EmsValue::Urlaub, MessageSubType),
+    boolField(13, 7, EmsValue::Ferien, MessageSubType),
+    boolField(13, 4, EmsValue::SchaltuhrEin, MessageSubType),
+    numericField(14, 1, 1, EmsValue::SollTemp, MessageSubType)
+};
+
+static constexpr EmsMessage::FieldDescriptor RC_HK_SCHEDULE_FIELDS[] = {
+    integerField(85, 1, EmsValue::PausenZeit, MessageSubType),
+    integerField(86, 1, EmsValue::PartyZeit, MessageSubType)
+};
+
+static constexpr EmsMessage::FieldDescriptor RC20_STATUS_FIELDS[] = {
+    boolField(0, 7, EmsValue::Tagbetrieb, MessageSubType),
+    numericField(2, 1, 2, EmsValue::RaumSollTemp, MessageSubType),
+    temperatureField(3, EmsValue::RaumIstTemp, MessageSubType)
+};
+
+static constexpr EmsMessage::FieldDescriptor WM_TEMP1_FIELDS[] = {
+    temperatureField(0, EmsValue::IstTemp, EmsValue::HK1),
+    /* Byte 2 = 0 -> Pumpe aus, 100 = 0x64 -> Pumpe an */
+    boolField(2, 2, EmsValue::PumpeAktiv, EmsValue::HK1)
+};
+
+static constexpr EmsMessage::FieldDescriptor WM_TEMP2_FIELDS[] = {
+    temperatureField(0, EmsValue::IstTemp, EmsValue::HK1)
+};
+
+static constexpr EmsMessage::FieldDescriptor MM_TEMP_FIELDS[] = {
+    numericField(0, 1, 1, EmsValue::SollTemp, MessageSubType),
+    temperatureField(1, EmsValue::IstTemp, MessageSubType),
+    integerField(3, 1, EmsValue::Mischersteuerung, MessageSubType),
+    /* Byte 3 = 0 -> Pumpe aus, 100 = 0x64 -> Pumpe an */
+    boolField(3, 2, EmsValue::PumpeAktiv, MessageSubType)
+};
+
+static constexpr EmsMessage::FieldDescriptor SOLAR_MONITOR_FIELDS[] = {
+    temperatureField(2, EmsValue::IstTemp, EmsValue::SolarKollektor),
+    integerField(4, 1, EmsValue::IstModulation, EmsValue::SolarPumpe),
+    temperatureField(5, EmsValue::IstTemp, EmsValue::SolarSpeicher),
+    boolField(7, 1, EmsValue::PumpeAktiv, EmsValue::Solar),
+    integerField(8, 3, EmsValue::BetriebsZeit, EmsValue::Solar)
+};
+
+#define FIELDS(table) table, sizeof(table) / sizeof(table[0])
+#define NO_FIELDS NULL, 0
+
+/*
+ * Not listed (thus reported as unhandled) are UBA type 0x07 (yet unknown
+ * contents: 0x8 0x0 0x7 0x0 0x3 0x3 0x0 0x2 0x0 0x0 ...), BC10 type 0x29
+ * (yet unknown: 0x9 0x10 0x29 0x0 0x6b) and RC3x type 0xA2 (unknown, 11 zeros).
+ */
+const EmsMessage::MessageBinding EmsMessage::BINDINGS[] = {
+    /* UBA messages */
+    { EmsProto::addressUBA, 0x10, EmsValue::None, NO_FIELDS, &EmsMessage::parseUBAErrorMessage, NULL },
+    { EmsProto::addressUBA, 0x11, EmsValue::None, NO_FIELDS, &EmsMessage::parseUBAErrorMessage, NULL },
+    { EmsProto::addressUBA, 0x14, EmsValue::None, FIELDS(UBA_TOTAL_UPTIME_FIELDS), NULL, NULL },
+    { EmsProto::addressUBA, 0x15, EmsValue::None, FIELDS(UBA_MAINTENANCE_SETTINGS_FIELDS), NULL, NULL },
+    { EmsProto::addressUBA, 0x16, EmsValue::None, FIELDS(UBA_PARAMETERS_FIELDS), NULL, NULL },
+    { EmsProto::addressUBA, 0x18, EmsValue::None, FIELDS(UBA_MONITOR_FAST_FIELDS),
+      NULL, &EmsMessage::parseUBAStatusCodes },
+    { EmsProto::addressUBA, 0x19, EmsValue::None, FIELDS(UBA_MONITOR_SLOW_FIELDS), NULL, NULL },
+    { EmsProto::addressUBA, 0x1C, EmsValue::None, FIELDS(UBA_MAINTENANCE_STATUS_FIELDS), NULL, NULL },
+    { EmsProto::addressUBA, 0x33, EmsValue::None, FIELDS(UBA_PARAMETER_WW_FIELDS), NULL, NULL },
+    { EmsProto::addressUBA, 0x34, EmsValue::None, FIELDS(UBA_MONITOR_WW_FIELDS),
+      NULL, &EmsMessage::parseUBACirculationMode },
+
+    /* RC30/35 messages */
+    { EmsProto::addressRC3x, 0x06, EmsValue::None, FIELDS(RC_TIME_FIELDS), NULL, NULL },
+    { EmsProto::addressRC3x, 0x1A, EmsValue::None, NO_FIELDS, NULL, NULL }, /* command for UBA3 */
+    { EmsProto::addressRC3x, 0x35, EmsValue::None, NO_FIELDS, NULL, NULL }, /* command for UBA3 */
+    { EmsProto::addressRC3x, 0x37, EmsValue::None, FIELDS(RC_WW_OPMODE_FIELDS), NULL, NULL },
+    { EmsProto::addressRC3x, 0x3D, EmsValue::HK1, FIELDS(RC_HK_OPMODE_FIELDS),
+      &EmsMessage::parseRCHKSystemFields, NULL },
+    { EmsProto::addressRC3x, 0x3E, EmsValue::HK1, FIELDS(RC_HK_MONITOR_FIELDS),
+      NULL, &EmsMessage::parseRCHKMonitorExtras },
+    { EmsProto::addressRC3x, 0x3F, EmsValue::HK1, FIELDS(RC_HK_SCHEDULE_FIELDS), NULL, NULL },
+    { EmsProto::addressRC3x, 0x47, EmsValue::HK2, FIELDS(RC_HK_OPMODE_FIELDS),
+      &EmsMessage::parseRCHKSystemFields, NULL },
+    { EmsProto::addressRC3x, 0x48, EmsValue::HK2, FIELDS(RC_HK_MONITOR_FIELDS),
+      NULL, &EmsMessage::parseRCHKMonitorExtras },
+    { EmsProto::addressRC3x, 0x49, EmsValue::HK2, FIELDS(RC_HK_SCHEDULE_FIELDS), NULL, NULL },
+    { EmsProto::addressRC3x, 0x51, EmsValue::HK3, FIELDS(RC_HK_OPMODE_FIELDS),
+      &EmsMessage::parseRCHKSystemFields, NULL },
+    { EmsProto::addressRC3x, 0x52, EmsValue::HK3, FIELDS(RC_HK_MONITOR_FIELDS),
+      NULL, &EmsMessage::parseRCHKMonitorExtras },
+    { EmsProto::addressRC3x, 0x53, EmsValue::HK3, FIELDS(RC_HK_SCHEDULE_FIELDS), NULL, NULL },
+    { EmsProto::addressRC3x, 0x5B, EmsValue::HK4, FIELDS(RC_HK_OPMODE_FIELDS),
+      &EmsMessage::parseRCHKSystemFields, NULL },
+    { EmsProto::addressRC3x, 0x5C, EmsValue::HK4, FIELDS(RC_HK_MONITOR_FIELDS),
+      NULL, &EmsMessage::parseRCHKMonitorExtras },
+    { EmsProto::addressRC3x, 0x5D, EmsValue::HK4, FIELDS(RC_HK_SCHEDULE_FIELDS), NULL, NULL },
+    { EmsProto::addressRC3x, 0x9D, EmsValue::None, NO_FIELDS, NULL, NULL }, /* command for WM10 */
+    { EmsProto::addressRC3x, 0xA3, EmsValue::None, FIELDS(RC_OUTDOOR_TEMP_FIELDS), NULL, NULL },
+    { EmsProto::addressRC3x, 0xA5, EmsValue::None, FIELDS(RC_SYSTEM_PARAMETER_FIELDS), NULL, NULL },
+    { EmsProto::addressRC3x, 0xAC, EmsValue::None, NO_FIELDS, NULL, NULL }, /* command for MM10 */
+
+    /* RC20 messages */
+    { EmsProto::addressRC2xStandalone, 0x1A, EmsValue::None, NO_FIELDS, NULL, NULL }, /* command for UBA3 */
+    { EmsProto::addressRC2xStandalone, 0xAE, EmsValue::HK1, FIELDS(RC20_STATUS_FIELDS), NULL, NULL },
+    { EmsProto::addressRC2xHK1, 0x1A, EmsValue::None, NO_FIELDS, NULL, NULL },
+    { EmsProto::addressRC2xHK1, 0xAE, EmsValue::HK1, FIELDS(RC20_STATUS_FIELDS), NULL, NULL },
+    { EmsProto::addressRC2xHK2, 0x1A, EmsValue::None, NO_FIELDS, NULL, NULL },
+    { EmsProto::addressRC2xHK2, 0xAE, EmsValue::HK2, FIELDS(RC20_STATUS_FIELDS), NULL, NULL },
+    { EmsProto::addressRC2xHK3, 0x1A, EmsValue::None, NO_FIELDS, NULL, NULL },
+    { EmsProto::addressRC2xHK3, 0xAE, EmsValue::HK3, FIELDS(RC20_STATUS_FIELDS), NULL, NULL },
+    { EmsProto::addressRC2xHK4, 0x1A, EmsValue::None, NO_FIELDS, NULL, NULL },
+    { EmsProto::addressRC2xHK4, 0xAE, EmsValue::HK4, FIELDS(RC20_STATUS_FIELDS), NULL, NULL },
+
+    /* WM10 messages */
+    { EmsProto::addressWM10, 0x1E, EmsValue::None, FIELDS(WM_TEMP2_FIELDS), NULL, NULL },
+    { EmsProto::addressWM10, 0x9C, EmsValue::None, FIELDS(WM_TEMP1_FIELDS), NULL, NULL },
+
+    /* MM10 messages */
+    { EmsProto::addressMM10HK1, 0xAB, EmsValue::HK1, FIELDS(MM_TEMP_FIELDS), NULL, NULL },
+    { EmsProto::addressMM10HK2, 0xAB, EmsValue::HK2, FIELDS(MM_TEMP_FIELDS), NULL, NULL },
+    { EmsProto::addressMM10HK3, 0xAB, EmsValue::HK3, FIELDS(MM_TEMP_FIELDS), NULL, NULL },
+    { EmsProto::addressMM10HK4, 0xAB, EmsValue::HK4, FIELDS(MM_TEMP_FIELDS), NULL, NULL },
+
+    /* SM10 messages */
+    { EmsProto::addressSM10, 0x97, EmsValue::None, FIELDS(SOLAR_MONITOR_FIELDS), NULL, NULL }
+};
+
+/*
+ * (source, type) -> binding lookup: the source address selects a row of
+ * the type table, which holds the binding index plus one (0 = unhandled).
+ * Built once at startup from BINDINGS.
+ */
+class EmsMessage::BindingIndex
+{
+    public:
+	BindingIndex() {
+	    uint8_t nextRow = 1;
+
+	    memset(m_rows, 0, sizeof(m_rows));
+	    memset(m_bindings, 0, sizeof(m_bindings));
+
+	    for (size_t i = 0; i < BindingCount; i++) {
+		const MessageBinding& binding = BINDINGS[i];
+		if (!m_rows[binding.source]) {
+		    m_rows[binding.source] = nextRow++;
+		}
+		m_bindings[m_rows[binding.source]][binding.type] = i + 1;
+	    }
+	}
+
+	const MessageBinding * find(uint8_t source, uint8_t type) const {
+	    uint8_t index = m_bindings[m_rows[source]][type];
+	    return index ? &BINDINGS[index - 1] : NULL;
+	}
+
+    private:
+	static const size_t BindingCount = sizeof(BINDINGS) / sizeof(BINDINGS[0]);
+	static_assert(BindingCount < 255, "binding index doesn't fit into the lookup table");
+
+	/* row 0 is shared by all sources without any binding */
+	uint8_t m_rows[256];
+	uint8_t m_bindings[BindingCount + 1][256];
+};
+
+const EmsMessage::BindingIndex EmsMessage::BINDING_INDEX;
+
 void
 EmsMessage::handle()
 {
-    bool handled = false;
     DebugStream& debug = Options::messageDebug();
 
     if (debug) {
@@ -215,14 +653,14 @@ EmsMessage::handle()
 	f % (unsigned int) m_type % (unsigned int) m_offset;
 
 	debug << f << ", data:";
-	for (size_t i = 0; i < m_data.size(); i++) {
+	for (size_t i = 0; i < m_length; i++) {
 	    debug << " 0x" << std::hex << std::setw(2)
 		  << std::setfill('0') << (unsigned int) m_data[i];
 	}
 	debug << std::endl;
     }
 
-    if (!m_valueHandler) {
+    if (!m_values) {
 	/* kind of pointless to parse in that case */
 	return;
     }
@@ -237,99 +675,9 @@ EmsMessage::handle()
 	return;
     }
 
-    switch (m_source) {
-	case EmsProto::addressUBA:
-	    /* UBA message */
-	    switch (m_type) {
-		case 0x07:
-		    /* yet unknown contents:
-		     * 0x8 0x0 0x7 0x0 0x3 0x3 0x0 0x2 0x0 0x0 0x0 0x0 0x0 0x0 0x0 0x0 0x0 */
-		    break;
-		case 0x10:
-		case 0x11:
-		    parseUBAErrorMessage();
-		    handled = true;
-		    break;
-		case 0x14: parseUBATotalUptimeMessage(); handled = true; break;
-		case 0x15: parseUBAMaintenanceSettingsMessage(); handled = true; break;
-		case 0x16: parseUBAParametersMessage(); handled = true; break;
-		case 0x18: parseUBAMonitorFastMessage(); handled = true; break;
-		case 0x19: parseUBAMonitorSlowMessage(); handled = true; break;
-		case 0x1C: parseUBAMaintenanceStatusMessage(); handled = true; break;
-		case 0x33: parseUBAParameterWWMessage(); handled = true; break;
-		case 0x34: parseUBAMonitorWWMessage(); handled = true; break;
-	    }
-	    break;
-	case EmsProto::addressBC10:
-	    /* BC10 message */
-	    switch (m_type) {
-		case 0x29:
-		    /* yet unknown: 0x9 0x10 0x29 0x0 0x6b */
-		    break;
-	    }
-	    break;
-	case EmsProto::addressRC3x:
-	    /* RC30/35 message */
-	    switch (m_type) {
-		case 0x06: parseRCTimeMessage(); handled = true; break;
-		case 0x1A: /* command for UBA3 */ handled = true; break;
-		case 0x35: /* command for UBA3 */ handled = true; break;
-		case 0x37: parseRCWWOpmodeMessage(); handled = true; break;
-		case 0x3D: parseRCHKOpmodeMessage(EmsValue::HK1); handled = true; break;
-		case 0x3E: parseRCHKMonitorMessage(EmsValue::HK1); handled = true; break;
-		case 0x3F: parseRCHKScheduleMessage(EmsValue::HK1); handled = true; break;
-		case 0x47: parseRCHKOpmodeMessage(EmsValue::HK2); handled = true; break;
-		case 0x48: parseRCHKMonitorMessage(EmsValue::HK2); handled = true; break;
-		case 0x49: parseRCHKScheduleMessage(EmsValue::HK2); handled = true; break;
-		case 0x51: parseRCHKOpmodeMessage(EmsValue::HK3); handled = true; break;
-		case 0x52: parseRCHKMonitorMessage(EmsValue::HK3); handled = true; break;
-		case 0x53: parseRCHKScheduleMessage(EmsValue::HK3); handled = true; break;
-		case 0x5B: parseRCHKOpmodeMessage(EmsValue::HK4); handled = true; break;
-		case 0x5C: parseRCHKMonitorMessage(EmsValue::HK4); handled = true; break;
-		case 0x5D: parseRCHKScheduleMessage(EmsValue::HK4); handled = true; break;
-		case 0x9D: /* command for WM10 */ handled = true; break;
-		case 0xA2: /* unknown, 11 zeros */ break;
-		case 0xA3: parseRCOutdoorTempMessage(); handled = true; break;
-		case 0xA5: parseRCSystemParameterMessage(); handled = true; break;
-		case 0xAC: /* command for MM10 */ handled = true; break;
-	    }
-	    break;
-	case EmsProto::addressRC2xStandalone:
-	case EmsProto::addressRC2xHK1:
-	case EmsProto::addressRC2xHK2:
-	case EmsProto::addressRC2xHK3:
-	case EmsProto::addressRC2xHK4:
-	    /* RC20 message */
-	    switch (m_type) {
-		case 0x1A: /* command for UBA3 */ handled = true; break;
-		case 0xAE: parseRC20StatusMessage(determineHKFromAddress(m_source)); handled = true; break;
-	    }
-	    break;
-	case EmsProto::addressWM10:
-	    /* WM10 message */
-	    switch (m_type) {
-		case 0x9C: parseWMTemp1Message(); handled = true; break;
-		case 0x1E: parseWMTemp2Message(); handled = true; break;
-	    }
-	    break;
-	case EmsProto::addressMM10HK1:
-	case EmsProto::addressMM10HK2:
-	case EmsProto::addressMM10HK3:
-	case EmsProto::addressMM10HK4:
-	    /* MM10 message */
-	    switch (m_type) {
-		case 0xAB: parseMMTempMessage(determineHKFromAddress(m_source)); handled = true; break;
-	    }
-	    break;
-	case EmsProto::addressSM10:
-	    /* SM10 message */
-	    switch (m_type) {
-		case 0x97: parseSolarMonitorMessage(); handled = true; break;
-	    }
-	    break;
-    }
+    const MessageBinding *binding = BINDING_INDEX.find(m_source, m_type);
 
-    if (!handled) {
+    if (!binding) {
 	DebugStream& dataDebug = Options::dataDebug();
 	if (dataDebug) {
 	    dataDebug << "DATA: Unhandled message received";
@@ -337,153 +685,133 @@ EmsMessage::handle()
 		    % (unsigned int) m_source % (unsigned int) m_dest % (unsigned int) m_type;
 	    dataDebug << std::endl;
 	}
+	return;
     }
-}
 
-void
-EmsMessage::parseEnum(size_t offset, EmsValue::Type type, EmsValue::SubType subtype)
-{
-    if (canAccess(offset, 1)) {
-	EmsValue value(type, subtype, m_data[offset - m_offset]);
-	m_valueHandler(value);
+    size_t slot = binding - BINDINGS;
+    if (m_shadow) {
+	m_shadowEntry = m_shadow->lookup(slot, time(NULL));
     }
-}
 
-void
-EmsMessage::parseNumeric(size_t offset, size_t size, int divider,
-			 EmsValue::Type type, EmsValue::SubType subtype,
-			 bool isSigned, const std::vector<const uint8_t *> *invalidValues)
-{
-    if (canAccess(offset, size)) {
-	EmsValue value(type, subtype, &m_data.at(offset - m_offset),
-		size, divider, isSigned, invalidValues);
-	m_valueHandler(value);
+    if (binding->preParser) {
+	(this->*binding->preParser)(binding->subtype);
     }
-}
-
-void
-EmsMessage::parseBool(size_t offset, uint8_t bit,
-		      EmsValue::Type type, EmsValue::SubType subtype)
-{
-    if (canAccess(offset, 1)) {
-	EmsValue value(type, subtype, m_data.at(offset - m_offset), bit);
-	m_valueHandler(value);
+    for (size_t i = 0; i < binding->fieldCount; i++) {
+	parseField(binding->fields[i], binding->subtype);
+    }
+    if (binding->postParser) {
+	(this->*binding->postParser)(binding->subtype);
     }
-}
 
-void
-EmsMessage::parseUBAMonitorFastMessage()
-{
-    parseNumeric(0, 1, 1, EmsValue::SollTemp, EmsValue::Kessel);
-    parseTemperature(1, EmsValue::IstTemp, EmsValue::Kessel);
-    parseInteger(3, 1, EmsValue::SollModulation, EmsValue::Brenner);
-    parseInteger(4, 1, EmsValue::IstModulation, EmsValue::Brenner);
-    parseBool(7, 0, EmsValue::FlammeAktiv, EmsValue::None);
-    parseBool(7, 2, EmsValue::BrennerAktiv, EmsValue::None);
-    parseBool(7, 3, EmsValue::ZuendungAktiv, EmsValue::None);
-    parseBool(7, 5, EmsValue::PumpeAktiv, EmsValue::Kessel);
-    parseBool(7, 6, EmsValue::DreiWegeVentilAufWW, EmsValue::None);
-    parseBool(7, 7, EmsValue::ZirkulationAktiv, EmsValue::None);
-    parseTemperature(13, EmsValue::IstTemp, EmsValue::Ruecklauf);
-    parseNumeric(15, 2, 10, EmsValue::Flammenstrom, EmsValue::None);
-    parseNumeric(17, 1, 10, EmsValue::Systemdruck, EmsValue::None, false);
-    parseTemperature(25, EmsValue::IstTemp, EmsValue::Ansaugluft);
-
-    if (canAccess(18, 2)) {
-	std::ostringstream ss;
-	ss << m_data[18] << m_data[19];
-	m_valueHandler(EmsValue(EmsValue::ServiceCode, EmsValue::None, ss.str()));
-    }
-    if (canAccess(20, 2)) {
-	std::ostringstream ss;
-	ss << std::dec << (m_data[20] << 8 | m_data[21]);
-	m_valueHandler(EmsValue(EmsValue::FehlerCode, EmsValue::None, ss.str()));
+    if (m_shadow) {
+	m_shadow->update(slot, m_offset, m_data, m_length);
     }
 }
 
-void
-EmsMessage::parseUBATotalUptimeMessage()
+EmsValueMask
+EmsMessage::lookupMask()
 {
-    parseInteger(0, 3, EmsValue::BetriebsZeit, EmsValue::None);
+    EmsValueMask mask;
+
+    /* see parseRCHKSystemFields() */
+    mask.set(EmsValue::HeizSystem);
+    return mask;
 }
 
-void
-EmsMessage::parseUBAMaintenanceSettingsMessage()
+const EmsValue *
+EmsMessage::findValue(EmsValue::Type type, EmsValue::SubType subtype) const
 {
-    parseEnum(0, EmsValue::Wartungsmeldungen, EmsValue::Kessel);
-    parseInteger(1, 1, EmsValue::HektoStundenVorWartung, EmsValue::Kessel);
-    if (canAccess(2, sizeof(EmsProto::DateRecord))) {
-	EmsProto::DateRecord *record = (EmsProto::DateRecord *) &m_data.at(2 - m_offset);
-	m_valueHandler(EmsValue(EmsValue::Wartungstermin, EmsValue::Kessel, *record));
+    /* values of this message didn't reach the cache yet */
+    for (auto iter = m_values->rbegin(); iter != m_values->rend(); ++iter) {
+	if (iter->getType() == type && iter->getSubType() == subtype) {
+	    return &(*iter);
+	}
     }
+
+    return m_cacheAccessor ? m_cacheAccessor(type, subtype) : NULL;
 }
 
 void
-EmsMessage::parseUBAMaintenanceStatusMessage()
+EmsMessage::parseField(const FieldDescriptor& field, EmsValue::SubType messageSubType,
+		       bool force)
 {
-    parseEnum(5, EmsValue::WartungFaellig, EmsValue::Kessel);
+    if (!canAccess(field.offset, field.size)) {
+	return;
+    }
+    if (!force && !hasChanged(field.offset, field.size,
+			      field.kind == BooleanField ? 1 << field.param : 0xff)) {
+	return;
+    }
+
+    EmsValue::SubType subtype = field.subtype == MessageSubType
+	    ? messageSubType : (EmsValue::SubType) field.subtype;
+    if (!isWanted(field.type, subtype)) {
+	return;
+    }
+
+    const uint8_t *data = &m_data[field.offset - m_offset];
+
+    switch (field.kind) {
+	case NumericField:
+	    m_values->emplace_back(field.type, subtype, data, field.size, field.param,
+		    field.flags & FieldSigned,
+		    field.flags & FieldTemperature ? &INVALID_TEMPERATURE_VALUES : NULL);
+	    break;
+	case BooleanField:
+	    m_values->emplace_back(field.type, subtype, data[0], field.param);
+	    break;
+	case EnumField:
+	    m_values->emplace_back(field.type, subtype, data[0]);
+	    break;
+	case KennlinieField:
+	    m_values->emplace_back(field.type, subtype, data[0], data[1], data[2]);
+	    break;
+	case DateField:
+	    m_values->emplace_back(field.type, subtype, *((const EmsProto::DateRecord *) data));
+	    break;
+	case SystemTimeField:
+	    m_values->emplace_back(field.type, subtype, *((const EmsProto::SystemTimeRecord *) data));
+	    break;
+    }
 }
 
 void
-EmsMessage::parseUBAMonitorSlowMessage()
+EmsMessage::parseUBAStatusCodes(EmsValue::SubType /* subtype */)
 {
-    parseTemperature(0, EmsValue::IstTemp, EmsValue::Aussen);
-    parseTemperature(2, EmsValue::IstTemp, EmsValue::Waermetauscher);
-    parseTemperature(4, EmsValue::IstTemp, EmsValue::Abgas);
-    parseInteger(9, 1, EmsValue::IstModulation, EmsValue::KesselPumpe);
-    parseInteger(10, 3, EmsValue::Brennerstarts, EmsValue::Kessel);
-    parseInteger(13, 3, EmsValue::BetriebsZeit, EmsValue::Kessel);
-    parseInteger(16, 3, EmsValue::BetriebsZeit2, EmsValue::Kessel);
-    parseInteger(19, 3, EmsValue::HeizZeit, EmsValue::Kessel);
+    if (canAccess(18, 2) && hasChanged(18, 2) && isWanted(EmsValue::ServiceCode, EmsValue::None)) {
+	const char code[] = { (char) m_data[18 - m_offset], (char) m_data[19 - m_offset], 0 };
+	m_values->emplace_back(EmsValue::ServiceCode, EmsValue::None, code);
+    }
+    if (canAccess(20, 2) && hasChanged(20, 2) && isWanted(EmsValue::FehlerCode, EmsValue::None)) {
+	char code[EmsValue::MaxTextLength + 1];
+	snprintf(code, sizeof(code), "%u", m_data[20 - m_offset] << 8 | m_data[21 - m_offset]);
+	m_values->emplace_back(EmsValue::FehlerCode, EmsValue::None, code);
+    }
 }
 
 void
-EmsMessage::parseUBAMonitorWWMessage()
+EmsMessage::parseUBACirculationMode(EmsValue::SubType /* subtype */)
 {
-    parseNumeric(0, 1, 1, EmsValue::SollTemp, EmsValue::WW);
-    parseTemperature(1, EmsValue::IstTemp, EmsValue::WW);
-    parseBool(5, 0, EmsValue::Tagbetrieb, EmsValue::WW);
-    parseBool(5, 1, EmsValue::EinmalLadungAktiv, EmsValue::WW);
-    parseBool(5, 2, EmsValue::DesinfektionAktiv, EmsValue::WW);
-    parseBool(5, 3, EmsValue::WarmwasserBereitung, EmsValue::None);
-    parseBool(5, 4, EmsValue::NachladungAktiv, EmsValue::WW);
-    parseBool(5, 5, EmsValue::WarmwasserTempOK, EmsValue::None);
-    parseBool(6, 0, EmsValue::Fuehler1Defekt, EmsValue::WW);
-    parseBool(6, 1, EmsValue::Fuehler2Defekt, EmsValue::WW);
-    parseBool(6, 2, EmsValue::Stoerung, EmsValue::WW);
-    parseBool(6, 3, EmsValue::StoerungDesinfektion, EmsValue::WW);
-    parseBool(7, 0, EmsValue::Tagbetrieb, EmsValue::Zirkulation);
-    parseBool(7, 2, EmsValue::ZirkulationAktiv, EmsValue::None);
-    parseBool(7, 3, EmsValue::Ladevorgang, EmsValue::WW);
-    parseEnum(8, EmsValue::WWSystemType, EmsValue::None);
-    parseNumeric(9, 1, 10, EmsValue::DurchflussMenge, EmsValue::WW, false);
-    parseInteger(10, 3, EmsValue::WarmwasserbereitungsZeit, EmsValue::None);
-    parseInteger(13, 3, EmsValue::WarmwasserBereitungen, EmsValue::None);
-
-    if (canAccess(7, 1)) {
+    if (canAccess(7, 1) && hasChanged(7, 1, 0x03) &&
+	    isWanted(EmsValue::Betriebsart, EmsValue::Zirkulation)) {
 	// offset 7, bit 1: manual mode
 	bool manual = m_data[7 - m_offset] & (1 << 1);
 	// offset 7, bit 0: manually enabled
 	bool enabled = m_data[7 - m_offset] & (1 << 0);
 	uint8_t mode = manual ? (enabled ? 1 : 0) : 2;
-	m_valueHandler(EmsValue(EmsValue::Betriebsart, EmsValue::Zirkulation, mode));
+	m_values->emplace_back(EmsValue::Betriebsart, EmsValue::Zirkulation, mode);
     }
 }
 
 void
-EmsMessage::parseUBAParameterWWMessage()
-{
-    parseBool(1, 0, EmsValue::KesselSchalter, EmsValue::WW);
-    parseNumeric(2, 1, 1, EmsValue::SetTemp, EmsValue::WW);
-    parseEnum(7, EmsValue::Schaltpunkte, EmsValue::Zirkulation);
-    parseNumeric(8, 1, 1, EmsValue::DesinfektionsTemp, EmsValue::WW);
-}
-
-void
-EmsMessage::parseUBAErrorMessage()
+EmsMessage::parseUBAErrorMessage(EmsValue::SubType /* subtype */)
 {
     size_t start;
 
+    if (!isWanted(EmsValue::Fehler, EmsValue::None)) {
+	return;
+    }
+
     if (m_offset % sizeof(EmsProto::ErrorRecord)) {
 	start = ((m_offset / sizeof(EmsProto::ErrorRecord)) + 1) * sizeof(EmsProto::ErrorRecord);
     } else {
@@ -491,68 +819,23 @@ EmsMessage::parseUBAErrorMessage()
     }
 
     while (canAccess(start, sizeof(EmsProto::ErrorRecord))) {
-	EmsProto::ErrorRecord *record = (EmsProto::ErrorRecord *) &m_data.at(start - m_offset);
-	unsigned int index = start / sizeof(EmsProto::ErrorRecord);
-	EmsValue::ErrorEntry entry = { m_type, index, *record };
+	if (hasChanged(start, sizeof(EmsProto::ErrorRecord))) {
+	    const EmsProto::ErrorRecord *record = (const EmsProto::ErrorRecord *) &m_data[start - m_offset];
+	    unsigned int index = start / sizeof(EmsProto::ErrorRecord);
+	    EmsValue::ErrorEntry entry = { m_type, index, *record };
 
-	m_valueHandler(EmsValue(EmsValue::Fehler, EmsValue::None, entry));
+	    m_values->emplace_back(EmsValue::Fehler, EmsValue::None, entry);
+	}
 	start += sizeof(EmsProto::ErrorRecord);
     }
 }
 
 void
-EmsMessage::parseUBAParametersMessage()
-{
-    parseBool(0, 1, EmsValue::KesselSchalter, EmsValue::Kessel);
-    parseNumeric(1, 1, 1, EmsValue::SetTemp, EmsValue::Kessel);
-    parseInteger(2, 1, EmsValue::MaxModulation, EmsValue::Brenner);
-    parseInteger(3, 1, EmsValue::MinModulation, EmsValue::Brenner);
-    parseNumeric(4, 1, 1, EmsValue::AusschaltHysterese, EmsValue::Kessel);
-    parseNumeric(5, 1, 1, EmsValue::EinschaltHysterese, EmsValue::Kessel);
-    parseInteger(6, 1, EmsValue::AntipendelZeit, EmsValue::None);
-    parseInteger(8, 1, EmsValue::NachlaufZeit, EmsValue::KesselPumpe);
-    parseInteger(9, 1, EmsValue::MaxModulation, EmsValue::KesselPumpe);
-    parseInteger(10, 1, EmsValue::MinModulation, EmsValue::KesselPumpe);
-}
-
-void
-EmsMessage::parseRCTimeMessage()
-{
-    if (canAccess(0, sizeof(EmsProto::SystemTimeRecord))) {
-	EmsProto::SystemTimeRecord *record = (EmsProto::SystemTimeRecord *) &m_data.at(0);
-	EmsValue value(EmsValue::SystemZeit, EmsValue::None, *record);
-	m_valueHandler(value);
-    }
-}
-
-void
-EmsMessage::parseRCWWOpmodeMessage()
-{
-    parseBool(0, 1, EmsValue::EigenesProgrammAktiv, EmsValue::WW);
-    parseBool(1, 1, EmsValue::EigenesProgrammAktiv, EmsValue::Zirkulation);
-    parseEnum(2, EmsValue::Betriebsart, EmsValue::WW);
-    parseEnum(3, EmsValue::Betriebsart, EmsValue::Zirkulation);
-    parseBool(4, 1, EmsValue::Desinfektion, EmsValue::WW);
-    parseEnum(5, EmsValue::DesinfektionTag, EmsValue::WW);
-    parseInteger(6, 1, EmsValue::DesinfektionStunde, EmsValue::WW);
-    parseNumeric(8, 1, 1, EmsValue::MaxTemp, EmsValue::WW);
-    parseBool(9 ,1, EmsValue::EinmalLadungsLED, EmsValue::WW);
-}
-
-void
-EmsMessage::parseRCSystemParameterMessage()
-{
-    parseNumeric(5, 1, 1, EmsValue::MinTemp, EmsValue::RC);
-    parseEnum(6, EmsValue::GebaeudeArt, EmsValue::RC);
-    parseBool(21, 1, EmsValue::ATDaempfung, EmsValue::RC);
-}
-
-void
-EmsMessage::parseRCHKOpmodeMessage(EmsValue::SubType subtype)
+EmsMessage::parseRCHKSystemFields(EmsValue::SubType subtype)
 {
     Options::RoomControllerType rcType = Options::roomControllerType();
 
-    if (rcType == Options::RC30 && canAccess(0, 1)) {
+    if (rcType == Options::RC30 && canAccess(0, 1) && hasChanged(0, 1)) {
 	uint8_t value = m_data[0];
 	uint8_t system, roomControlled;
 	if (value == 4 || value == 5) {
@@ -562,144 +845,46 @@ EmsMessage::parseRCHKOpmodeMessage(EmsValue::SubType subtype)
 	    system = value;
 	    roomControlled = 0;
 	}
-	m_valueHandler(EmsValue(EmsValue::HeizSystem, subtype, system));
-	m_valueHandler(EmsValue(EmsValue::FuehrungsGroesse, subtype, roomControlled));
+	m_values->emplace_back(EmsValue::HeizSystem, subtype, system);
+	if (isWanted(EmsValue::FuehrungsGroesse, subtype)) {
+	    m_values->emplace_back(EmsValue::FuehrungsGroesse, subtype, roomControlled);
+	}
     } else if (rcType == Options::RC35) {
-	parseEnum(32, EmsValue::HeizSystem, subtype);
-	parseEnum(33, EmsValue::FuehrungsGroesse, subtype);
+	parseField(enumField(32, EmsValue::HeizSystem, MessageSubType), subtype);
+	parseField(enumField(33, EmsValue::FuehrungsGroesse, MessageSubType), subtype);
     }
 
-    const EmsValue *systemValue = m_cacheAccessor
-	    ? m_cacheAccessor(EmsValue::HeizSystem, subtype) : NULL;
+    const EmsValue *systemValue = findValue(EmsValue::HeizSystem, subtype);
     bool isFloorHeating = systemValue && systemValue->isValid()
 	    && systemValue->getValue<uint8_t>() == 3;
 
-    parseNumeric(1, 1, 2, EmsValue::NachtTemp, subtype);
-    parseNumeric(2, 1, 2, EmsValue::TagTemp, subtype);
-    parseNumeric(3, 1, 2, EmsValue::UrlaubTemp, subtype);
-    parseNumeric(4, 1, 2, EmsValue::RaumEinfluss, subtype);
-    parseNumeric(6, 1, 2, EmsValue::RaumOffset, subtype);
-    parseEnum(7, EmsValue::Betriebsart, subtype);
-    parseBool(8, 0, EmsValue::Estrichtrocknung, subtype);
+    /* the fields below move when the heating system changes */
+    bool systemChanged = (rcType == Options::RC30 && canAccess(0, 1) && hasChanged(0, 1)) ||
+	    (rcType == Options::RC35 && canAccess(32, 1) && hasChanged(32, 1));
+
     if (rcType == Options::RC35 && isFloorHeating) {
-	parseNumeric(35, 1, 1, EmsValue::MaxTemp, subtype);
-	parseNumeric(36, 1, 1, EmsValue::AuslegungsTemp, subtype);
+	parseField(numericField(35, 1, 1, EmsValue::MaxTemp, MessageSubType), subtype, systemChanged);
+	parseField(numericField(36, 1, 1, EmsValue::AuslegungsTemp, MessageSubType), subtype, systemChanged);
     } else {
-	parseNumeric(15, 1, 1, EmsValue::MaxTemp, subtype);
-	parseNumeric(17, 1, 1, EmsValue::AuslegungsTemp, subtype);
-    }
-    parseNumeric(16, 1, 1, EmsValue::MinTemp, subtype);
-    parseBool(19, 1, EmsValue::SchaltzeitOptimierung, subtype);
-    parseNumeric(22, 1, 1, EmsValue::SchwelleSommerWinter, subtype);
-    parseNumeric(23, 1, 1, EmsValue::FrostSchutzTemp, subtype);
-    parseEnum(25, EmsValue::AbsenkModus, subtype);
-    parseEnum(26, EmsValue::FBTyp, subtype);
-    parseEnum(28, EmsValue::Frostschutz, subtype);
-    parseNumeric(37, 1, 2, EmsValue::RaumUebersteuerTemp, subtype);
-    parseNumeric(38, 1, 1, EmsValue::AbsenkungsAbbruchTemp, subtype);
-    parseNumeric(39, 1, 1, EmsValue::AbsenkungsSchwellenTemp, subtype);
-    parseNumeric(40, 1, 1, EmsValue::UrlaubAbsenkungsSchwellenTemp, subtype);
-    parseEnum(41, EmsValue::UrlaubAbsenkungsArt, subtype);
-}
-
-void
-EmsMessage::parseRCHKScheduleMessage(EmsValue::SubType subtype)
-{
-    parseInteger(85, 1, EmsValue::PausenZeit, subtype);
-    parseInteger(86, 1, EmsValue::PartyZeit, subtype);
-}
-
-void
-EmsMessage::parseRCOutdoorTempMessage()
-{
-    parseNumeric(0, 1, 1, EmsValue::GedaempfteTemp, EmsValue::Aussen);
+	parseField(numericField(15, 1, 1, EmsValue::MaxTemp, MessageSubType), subtype, systemChanged);
+	parseField(numericField(17, 1, 1, EmsValue::AuslegungsTemp, MessageSubType), subtype, systemChanged);
+    }
 }
 
 void
-EmsMessage::parseRCHKMonitorMessage(EmsValue::SubType subtype)
+EmsMessage::parseRCHKMonitorExtras(EmsValue::SubType subtype)
 {
-    parseBool(0, 0, EmsValue::Ausschaltoptimierung, subtype);
-    parseBool(0, 1, EmsValue::Einschaltoptimierung, subtype);
-    parseBool(0, 3, EmsValue::WWVorrang, subtype);
-    parseBool(0, 4, EmsValue::Estrichtrocknung, subtype);
-    parseBool(0, 6, EmsValue::Frostschutzbetrieb, subtype);
-    parseBool(1, 0, EmsValue::Sommerbetrieb, subtype);
-    parseBool(1, 1, EmsValue::Tagbetrieb, subtype);
-
-    if (canAccess(0, 2)) {
+    if (canAccess(0, 2) && (hasChanged(0, 1, 1 << 2) || hasChanged(1, 1, 1 << 1)) &&
+	    isWanted(EmsValue::Betriebsart, subtype)) {
 	// offset 0, bit 2: auto mode
 	bool automatic = m_data[0] & (1 << 2);
 	// offset 1, bit 1: day mode
 	bool day = m_data[1] & (1 << 1);
 	uint8_t mode = automatic ? 2 : day ? 1 : 0;
-	m_valueHandler(EmsValue(EmsValue::Betriebsart, subtype, mode));
-    }
-
-    parseNumeric(2, 1, 2, EmsValue::RaumSollTemp, subtype);
-    parseTemperature(3, EmsValue::RaumIstTemp, subtype);
-    parseInteger(5, 1, EmsValue::EinschaltoptimierungsZeit, subtype);
-    parseInteger(6, 1, EmsValue::AusschaltoptimierungsZeit, subtype);
-
-    if (canAccess(7, 3)) {
-	EmsValue value(EmsValue::HKKennlinie, subtype, m_data[7 - m_offset],
-		m_data[8 - m_offset], m_data[9 - m_offset]);
-	m_valueHandler(value);
+	m_values->emplace_back(EmsValue::Betriebsart, subtype, mode);
     }
 
     if (canAccess(10, 1) && (m_data[10 - m_offset] & 1) == 0) {
-	parseNumeric(10, 2, 100, EmsValue::RaumTemperaturAenderung, subtype);
+	parseField(numericField(10, 2, 100, EmsValue::RaumTemperaturAenderung, MessageSubType), subtype);
     }
-
-    parseNumeric(12, 1, 1, EmsValue::SollLeistung, subtype);
-    parseBool(13, 2, EmsValue::Party, subtype);
-    parseBool(13, 3, EmsValue::Pause, subtype);
-    parseBool(13, 6, EmsValue::Urlaub, subtype);
-    parseBool(13, 7, EmsValue::Ferien, subtype);
-    parseBool(13, 4, EmsValue::SchaltuhrEin, subtype);
-    parseNumeric(14, 1, 1, EmsValue::SollTemp, subtype);
-}
-
-void
-EmsMessage::parseRC20StatusMessage(EmsValue::SubType subtype)
-{
-    parseBool(0, 7, EmsValue::Tagbetrieb, subtype);
-    parseNumeric(2, 1, 2, EmsValue::RaumSollTemp, subtype);
-    parseTemperature(3, EmsValue::RaumIstTemp, subtype);
-}
-
-void
-EmsMessage::parseWMTemp1Message()
-{
-    parseTemperature(0, EmsValue::IstTemp, EmsValue::HK1);
-
-    /* Byte 2 = 0 -> Pumpe aus, 100 = 0x64 -> Pumpe an */
-    parseBool(2, 2, EmsValue::PumpeAktiv, EmsValue::HK1);
 }
-
-void
-EmsMessage::parseWMTemp2Message()
-{
-    parseTemperature(0, EmsValue::IstTemp, EmsValue::HK1);
-}
-
-void
-EmsMessage::parseMMTempMessage(EmsValue::SubType subtype)
-{
-    parseNumeric(0, 1, 1, EmsValue::SollTemp, subtype);
-    parseTemperature(1, EmsValue::IstTemp, subtype);
-    parseInteger(3, 1, EmsValue::Mischersteuerung, subtype);
-
-    /* Byte 3 = 0 -> Pumpe aus, 100 = 0x64 -> Pumpe an */
-    parseBool(3, 2, EmsValue::PumpeAktiv, subtype);
-}
-
-void
-EmsMessage::parseSolarMonitorMessage()
-{
-    parseTemperature(2, EmsValue::IstTemp, EmsValue::SolarKollektor);
-    parseInteger(4, 1, EmsValue::IstModulation, EmsValue::SolarPumpe);
-    parseTemperature(5, EmsValue::IstTemp, EmsValue::SolarSpeicher);
-    parseBool(7, 1, EmsValue::PumpeAktiv, EmsValue::Solar);
-    parseInteger(8, 3, EmsValue::BetriebsZeit, EmsValue::Solar);
-}
-
@@ -20,12 +20,19 @@
 #ifndef __EMSMESSAGE_H__
 #define __EMSMESSAGE_H__
 
+#include <time.h>
+#include <array>
+#include <bitset>
+#include <cstring>
+#include <string>
 #include <vector>
 #ifdef HAVE_MQTT // as per its README, mqtt_client_cpp requires its config to be included prior to the boost::variant include
 # include <mqtt/config.hpp>
 #endif
 #include <boost/function.hpp>
-#include <boost/variant.hpp>
+#include <boost/shared_ptr.hpp>
+#include "Noncopyable.h"
+#include "PayloadShadow.h"
 
 class EmsProto {
     public:
@@ -250,23 +257,20 @@ class EmsValue {
 	    Formatted
 	};
 
+	/* number of Type and SubType entries, for tables indexed by them */
+	static const size_t TypeCount = FehlerCode + 1;
+	static const size_t SubTypeCount = SolarKollektor + 1;
+
 	struct ErrorEntry {
 	    uint8_t type;
 	    unsigned int index;
 	    EmsProto::ErrorRecord record;
 	};
 
-	typedef boost::variant<
-	    float, // numeric
-	    unsigned int, // integer
-	    bool, // boolean
-	    uint8_t, // enumeration
-	    std::vector<uint8_t>, // kennlinie
-	    ErrorEntry, // error
-	    EmsProto::DateRecord, // date
-	    EmsProto::SystemTimeRecord, // systemtime
-	    std::string // formatted
-	> Reading;
+	typedef std::array<uint8_t, 3> KennlinieRecord;
+
+	/* service codes are 2 characters, error codes up to 5 digits */
+	static const size_t MaxTextLength = 7;
 
     public:
 	EmsValue(Type type, SubType subType, const uint8_t *value, size_t len, int divider,
@@ -277,22 +281,63 @@ class EmsValue {
 	EmsValue(Type type, SubType subType, const ErrorEntry& error);
 	EmsValue(Type type, SubType subType, const EmsProto::DateRecord& date);
 	EmsValue(Type type, SubType subType, const EmsProto::SystemTimeRecord& time);
-	EmsValue(Type type, SubType subType, const std::string& value);
+	EmsValue(Type type, SubType subType, const char *value);
 
 	Type getType() const {
-	    return m_type;
+	    return (Type) m_type;
 	}
 	SubType getSubType() const {
-	    return m_subType;
+	    return (SubType) m_subType;
 	}
 	ReadingType getReadingType() const {
-	    return m_readingType;
+	    return (ReadingType) m_readingType;
 	}
 	bool isValid() const {
 	    return m_isValid;
 	}
-	template<typename T> const T& getValue() const {
-	    return boost::get<T>(m_value);
+
+	/* conversion happens on access, see the specializations below */
+	template<typename T> T getValue() const;
+
+	/* unscaled value and divider of numeric and integer values */
+	int getRawValue() const {
+	    return m_value.raw;
+	}
+	unsigned int getDivider() const {
+	    return m_divider;
+	}
+	const char * getText() const {
+	    return m_value.text;
+	}
+
+	/* numeric, integer, boolean and enumeration values fit into an int,
+	 * which allows storing them compactly (e.g. for the value history) */
+	bool hasScalarValue() const {
+	    return m_readingType == Numeric || m_readingType == Integer ||
+		    m_readingType == Boolean || m_readingType == Enumeration;
+	}
+	int getScalarValue() const {
+	    switch (m_readingType) {
+		case Boolean: return m_value.boolean;
+		case Enumeration: return m_value.enumeration;
+		default: return m_value.raw;
+	    }
+	}
+	EmsValue withScalarValue(int value, bool isValid) const {
+	    EmsValue result(*this);
+	    switch (m_readingType) {
+		case Boolean: result.m_value.boolean = value != 0; break;
+		case Enumeration: result.m_value.enumeration = value; break;
+		default: result.m_value.raw = value; break;
+	    }
+	    result.m_isValid = isValid;
+	    return result;
+	}
+
+	/* compares type and reading, ignoring unused parts of the value storage */
+	bool operator==(const EmsValue& other) const;
+	bool operator!=(const EmsValue& other) const {
+	    return !(*this == other);
 	}
 
 	// convenience shortcut
@@ -301,20 +346,148 @@ class EmsValue {
 	}
 
     private:
-	Type m_type;
-	SubType m_subType;
-	ReadingType m_readingType;
-	Reading m_value;
+	uint8_t m_type;
+	uint8_t m_subType;
+	uint8_t m_readingType;
 	bool m_isValid;
+	/* 0 for integer values */
+	uint16_t m_divider;
+	union {
+	    int raw; // numeric, integer
+	    bool boolean;
+	    uint8_t enumeration;
+	    uint8_t kennlinie[3];
+	    ErrorEntry error;
+	    EmsProto::DateRecord date;
+	    EmsProto::SystemTimeRecord systemTime;
+	    char text[MaxTextLength + 1]; // formatted
+	} m_value;
+};
+
+template<> inline float EmsValue::getValue<float>() const {
+    return m_divider ? (float) m_value.raw / (float) m_divider : (float) m_value.raw;
+}
+template<> inline unsigned int EmsValue::getValue<unsigned int>() const {
+    return (unsigned int) m_value.raw;
+}
+template<> inline bool EmsValue::getValue<bool>() const {
+    return m_value.boolean;
+}
+template<> inline uint8_t EmsValue::getValue<uint8_t>() const {
+    return m_value.enumeration;
+}
+template<> inline EmsValue::KennlinieRecord EmsValue::getValue<EmsValue::KennlinieRecord>() const {
+    return {{ m_value.kennlinie[0], m_value.kennlinie[1], m_value.kennlinie[2] }};
+}
+template<> inline EmsValue::ErrorEntry EmsValue::getValue<EmsValue::ErrorEntry>() const {
+    return m_value.error;
+}
+template<> inline EmsProto::DateRecord EmsValue::getValue<EmsProto::DateRecord>() const {
+    return m_value.date;
+}
+template<> inline EmsProto::SystemTimeRecord EmsValue::getValue<EmsProto::SystemTimeRecord>() const {
+    return m_value.systemTime;
+}
+template<> inline std::string EmsValue::getValue<std::string>() const {
+    return m_value.text;
+}
+
+/* set of (type, subtype) combinations a value consumer is interested in */
+class EmsValueMask
+{
+    public:
+	static EmsValueMask all() {
+	    EmsValueMask mask;
+	    mask.m_bits.set();
+	    return mask;
+	}
+
+	void set(EmsValue::Type type, EmsValue::SubType subType) {
+	    m_bits.set(index(type, subType));
+	}
+	/* all subtypes of the given type */
+	void set(EmsValue::Type type) {
+	    for (size_t subType = 0; subType < EmsValue::SubTypeCount; subType++) {
+		m_bits.set(index(type, (EmsValue::SubType) subType));
+	    }
+	}
+	/* all types with the given subtype */
+	void set(EmsValue::SubType subType) {
+	    for (size_t type = 0; type < EmsValue::TypeCount; type++) {
+		m_bits.set(index((EmsValue::Type) type, subType));
+	    }
+	}
+	bool test(EmsValue::Type type, EmsValue::SubType subType) const {
+	    return m_bits.test(index(type, subType));
+	}
+	bool isAll() const {
+	    return m_bits.all();
+	}
+
+	EmsValueMask& operator|=(const EmsValueMask& other) {
+	    m_bits |= other.m_bits;
+	    return *this;
+	}
+
+    private:
+	static size_t index(EmsValue::Type type, EmsValue::SubType subType) {
+	    return type * EmsValue::SubTypeCount + subType;
+	}
+
+	std::bitset<EmsValue::TypeCount * EmsValue::SubTypeCount> m_bits;
+};
+
+class ValueEnvelope;
+
+/* all values decoded from a single message, received at the same time */
+class EmsValueBatch
+{
+    public:
+	typedef boost::shared_ptr<const ValueEnvelope> EnvelopePtr;
+
+	/* envelopes, if given, is filled in by the sinks as they need them */
+	EmsValueBatch(const EmsValue *values, size_t count, time_t timestamp,
+		      EnvelopePtr *envelopes = NULL) :
+	    m_values(values),
+	    m_count(count),
+	    m_timestamp(timestamp),
+	    m_envelopes(envelopes)
+	{ }
+
+	const EmsValue * begin() const {
+	    return m_values;
+	}
+	const EmsValue * end() const {
+	    return m_values + m_count;
+	}
+	size_t size() const {
+	    return m_count;
+	}
+	time_t timestamp() const {
+	    return m_timestamp;
+	}
+	EnvelopePtr * envelopes() const {
+	    return m_envelopes;
+	}
+
+    private:
+	const EmsValue *m_values;
+	size_t m_count;
+	time_t m_timestamp;
+	EnvelopePtr *m_envelopes;
 };
 
-class EmsMessage
+/* received messages refer to the frame they were decoded from, so they
+ * must not outlive it */
+class EmsMessage : private boost::noncopyable
 {
     public:
-	typedef boost::function<void (const EmsValue& value)> ValueHandler;
+	typedef std::vector<EmsValue> ValueBuffer;
 	typedef boost::function<const EmsValue * (EmsValue::Type type, EmsValue::SubType subtype)> CacheAccessor;
 
-	EmsMessage(ValueHandler& valueHandler, CacheAccessor cacheAccesor, const std::vector<uint8_t>& data);
+	EmsMessage(ValueBuffer& values, CacheAccessor cacheAccesor,
+		   const uint8_t *data, size_t length, PayloadShadow *shadow = NULL,
+		   const EmsValueMask *mask = NULL);
 	EmsMessage(uint8_t dest, uint8_t type, uint8_t offset,
 		   const std::vector<uint8_t>& data, bool expectResponse);
 	EmsMessage(uint8_t dest, uint8_t source, uint8_t type, uint8_t offset,
@@ -322,6 +495,9 @@ class EmsMessage
 
 	void handle();
 
+	/* values which are looked up in the cache while decoding */
+	static EmsValueMask lookupMask();
+
     public:
 	uint8_t getSource() const {
 	    return m_source;
@@ -335,76 +511,72 @@ class EmsMessage
 	uint8_t getOffset() const {
 	    return m_offset;
 	}
-	const std::vector<uint8_t>& getData() const {
+	const uint8_t * getData() const {
 	    return m_data;
 	}
+	size_t getDataLength() const {
+	    return m_length;
+	}
 	std::vector<uint8_t> getSendData(bool omitSenderAddress) const;
 
-    private:
-	void parseUBATotalUptimeMessage();
-	void parseUBAMonitorFastMessage();
-	void parseUBAMonitorSlowMessage();
-	void parseUBAMonitorWWMessage();
-	void parseUBAMaintenanceSettingsMessage();
-	void parseUBAMaintenanceStatusMessage();
-	void parseUBAParameterWWMessage();
-	void parseUBAUnknown1Message();
-	void parseUBAErrorMessage();
-	void parseUBAParametersMessage();
-
-	void parseRCTimeMessage();
-	void parseRCOutdoorTempMessage();
-	void parseRCSystemParameterMessage();
-	void parseRCWWOpmodeMessage();
-	void parseRCHKMonitorMessage(EmsValue::SubType subType);
-	void parseRCHKOpmodeMessage(EmsValue::SubType subType);
-	void parseRCHKScheduleMessage(EmsValue::SubType subType);
-	void parseRC20StatusMessage(EmsValue::SubType subType);
-
-	void parseWMTemp1Message();
-	void parseWMTemp2Message();
-
-	void parseMMTempMessage(EmsValue::SubType subType);
-
-	void parseSolarMonitorMessage();
+    public:
+	/* layout of a single value inside a message, see EmsMessage.cpp */
+	struct FieldDescriptor;
 
     private:
-	void parseNumeric(size_t offset, size_t size, int divider,
-			  EmsValue::Type type, EmsValue::SubType subtype, bool isSigned = true,
-			  const std::vector<const uint8_t *> *invalidValues = NULL);
-	void parseInteger(size_t offset, size_t size,
-			  EmsValue::Type type, EmsValue::SubType subtype) {
-	    parseNumeric(offset, size, 0, type, subtype, false);
-	}
-	void parseTemperature(size_t offset, EmsValue::Type type, EmsValue::SubType subtype) {
-	    parseNumeric(offset, 2, 10, type, subtype, true, &INVALID_TEMPERATURE_VALUES);
+	typedef void (EmsMessage::*Parser)(EmsValue::SubType subtype);
+
+	struct MessageBinding {
+	    uint8_t source;
+	    uint8_t type;
+	    /* subtype for fields which depend on the message (e.g. HK1..HK4) */
+	    EmsValue::SubType subtype;
+	    const FieldDescriptor *fields;
+	    size_t fieldCount;
+	    /* for fields which can't be described by a table entry */
+	    Parser preParser;
+	    Parser postParser;
+	};
+	class BindingIndex;
+
+	void parseField(const FieldDescriptor& field, EmsValue::SubType messageSubType,
+			bool force = false);
+
+	void parseUBAStatusCodes(EmsValue::SubType subtype);
+	void parseUBACirculationMode(EmsValue::SubType subtype);
+	void parseUBAErrorMessage(EmsValue::SubType subtype);
+	void parseRCHKSystemFields(EmsValue::SubType subtype);
+	void parseRCHKMonitorExtras(EmsValue::SubType subtype);
+
+	const EmsValue * findValue(EmsValue::Type type, EmsValue::SubType subtype) const;
+	bool isWanted(EmsValue::Type type, EmsValue::SubType subtype) const {
+	    return !m_mask || m_mask->test(type, subtype);
 	}
-	void parseBool(size_t offset, uint8_t bit,
-		       EmsValue::Type type, EmsValue::SubType subtype);
-	void parseEnum(size_t offset,
-		       EmsValue::Type type, EmsValue::SubType subtype);
 
 	bool canAccess(size_t offset, size_t size) {
-	    return offset >= m_offset && offset + size <= m_offset + m_data.size();
+	    return offset >= m_offset && offset + size <= m_offset + m_length;
 	}
-	EmsValue::SubType determineHKFromAddress(uint8_t address) {
-	    if (address == EmsProto::addressRC2xHK2 || address == EmsProto::addressMM10HK2) {
-		return EmsValue::HK2;
-	    }
-	    if (address == EmsProto::addressRC2xHK3 || address == EmsProto::addressMM10HK4) {
-		return EmsValue::HK3;
-	    }
-	    if (address == EmsProto::addressRC2xHK4 || address == EmsProto::addressMM10HK4) {
-		return EmsValue::HK4;
-	    }
-	    return EmsValue::HK1;
+	/* whether the (masked) bytes differ from the last received payload,
+	 * needs canAccess() to be true for the given range */
+	bool hasChanged(size_t offset, size_t size, uint8_t mask = 0xff) {
+	    return !m_shadowEntry ||
+		    m_shadowEntry->hasChanged(offset, &m_data[offset - m_offset], size, mask);
 	}
 
     private:
+	static const MessageBinding BINDINGS[];
+	static const BindingIndex BINDING_INDEX;
 	static const std::vector<const uint8_t *> INVALID_TEMPERATURE_VALUES;
-	ValueHandler m_valueHandler;
+	ValueBuffer *m_values;
 	CacheAccessor m_cacheAccessor;
-	std::vector<unsigned char> m_data;
+	PayloadShadow *m_shadow;
+	const PayloadShadow::Entry *m_shadowEntry;
+	const EmsValueMask *m_mask;
+	/* payload of messages built for sending */
+	std::vector<uint8_t> m_sendData;
+	/* payload, either m_sendData or the received frame */
+	const uint8_t *m_data;
+	size_t m_length;
 	uint8_t m_source;
 	uint8_t m_dest;
 	uint8_t m_type;
@@ -0,0 +1,363 @@
+/*
+ * Buderus EMS data collector
+ *
+ * Copyright (C) 2011 Danny Baumann <dannybaumann@web.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Value formatting microbenchmark: formats sample values of every reading
+ * type with ValueApi::formatValue() (into a buffer and as std::string) and
+ * with the stream based implementation it replaced, checks that all of
+ * them produce the same output and prints time and allocations per value
+ * as JSON.
+ *
+ * Build with 'make benchmark', run as
+ *   ./format-benchmark [--iterations <n>]
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+#include "ApiCommandParser.h"
+#include "ValueApi.h"
+#include "ValueMetadata.h"
+
+static unsigned long long allocationCount = 0;
+
+/* keep the replacements out of line, gcc otherwise complains about
+ * free() being called on memory from operator new */
+void * __attribute__((noinline))
+operator new(size_t size)
+{
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+	throw std::bad_alloc();
+    }
+    allocationCount++;
+    return p;
+}
+
+void __attribute__((noinline))
+operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+typedef std::chrono::steady_clock Clock;
+
+/* ValueApi::formatValue() before it wrote into buffers, as reference */
+static std::string
+legacyFormatValue(const EmsValue& value)
+{
+    std::ostringstream stream;
+
+    switch (value.getReadingType()) {
+	case EmsValue::Numeric:
+	    if (!value.isValid()) {
+		stream << "unavailable";
+	    } else {
+		stream << value.getValue<float>();
+	    }
+	    break;
+	case EmsValue::Integer:
+	    if (!value.isValid()) {
+		stream << "unavailable";
+	    } else {
+		stream << value.getValue<unsigned int>();
+	    }
+	    break;
+	case EmsValue::Boolean:
+	    stream << (value.getValue<bool>() ? "on" : "off");
+	    break;
+	case EmsValue::Enumeration: {
+	    uint8_t enumValue = value.getValue<uint8_t>();
+	    const ValueMetadata::EnumLabel *label =
+		    ValueMetadata::findLabel(ValueMetadata::labels(value), enumValue);
+	    if (label && label->name) {
+		stream << label->name;
+	    } else {
+		stream << (unsigned int) enumValue;
+	    }
+	    break;
+	}
+	case EmsValue::Kennlinie: {
+	    EmsValue::KennlinieRecord kennlinie = value.getValue<EmsValue::KennlinieRecord>();
+	    stream << boost::format("%d/%d/%d")
+		    % (unsigned int) kennlinie[0] % (unsigned int) kennlinie[1]
+		    % (unsigned int) kennlinie[2];
+	    break;
+	}
+	case EmsValue::Error: {
+	    EmsValue::ErrorEntry entry = value.getValue<EmsValue::ErrorEntry>();
+	    std::string formatted = ApiCommandParser::buildRecordResponse(&entry.record);
+	    if (formatted.empty()) {
+		formatted = "empty";
+	    }
+
+	    const ValueMetadata::EnumLabel *label =
+		    ValueMetadata::findLabel(ValueMetadata::labels(value), entry.type);
+	    stream << boost::format("%s%02d %s")
+		    % (label ? label->name : "?") % entry.index % formatted;
+	    break;
+	}
+	case EmsValue::Date: {
+	    EmsProto::DateRecord record = value.getValue<EmsProto::DateRecord>();
+	    stream << boost::format("%04d-%02d-%02d")
+		    % (2000 + record.year) % (unsigned int) record.month
+		    % (unsigned int) record.day;
+	    break;
+	}
+	case EmsValue::SystemTime: {
+	    EmsProto::SystemTimeRecord record = value.getValue<EmsProto::SystemTimeRecord>();
+	    stream << boost::format("%04d-%02d-%02d %02d:%02d:%02d")
+		    % (2000 + record.common.year) % (unsigned int) record.common.month
+		    % (unsigned int) record.common.day % (unsigned int) record.common.hour
+		    % (unsigned int)  record.common.minute % (unsigned int) record.second;
+	    break;
+	}
+	case EmsValue::Formatted:
+	    stream << value.getValue<std::string>();
+	    break;
+    }
+
+    return stream.str();
+}
+
+static const char *
+readingTypeName(EmsValue::ReadingType type)
+{
+    switch (type) {
+	case EmsValue::Numeric: return "numeric";
+	case EmsValue::Integer: return "integer";
+	case EmsValue::Boolean: return "boolean";
+	case EmsValue::Enumeration: return "enumeration";
+	case EmsValue::Kennlinie: return "kennlinie";
+	case EmsValue::Error: return "error";
+	case EmsValue::Date: return "date";
+	case EmsValue::SystemTime: return "systemtime";
+	case EmsValue::Formatted: return "formatted";
+    }
+    return "unknown";
+}
+
+static void
+buildSamples(EmsValue::ReadingType type, std::vector<EmsValue>& samples)
+{
+    static const size_t SampleCount = 64;
+    static const int DIVIDERS[] = { 1, 2, 10, 100 };
+    static const char *TEXTS[] = { "0Y", "0H", "6A", "1234", "22", "" };
+    std::mt19937 random(type);
+
+    for (size_t i = 0; i < SampleCount; i++) {
+	uint8_t data[4] = { (uint8_t) random(), (uint8_t) random(),
+			    (uint8_t) random(), (uint8_t) random() };
+
+	switch (type) {
+	    case EmsValue::Numeric:
+		/* mostly plausible temperatures, but also extremes */
+		if (i % 4 != 0) {
+		    data[0] = i % 8 == 1 ? 0xff : 0;
+		}
+		samples.emplace_back(EmsValue::IstTemp, EmsValue::Kessel, data, 2,
+				     DIVIDERS[i % 4], true);
+		break;
+	    case EmsValue::Integer:
+		samples.emplace_back(EmsValue::BetriebsZeit, EmsValue::Kessel, data,
+				     1 + i % 4, 0, false);
+		break;
+	    case EmsValue::Boolean:
+		samples.emplace_back(EmsValue::FlammeAktiv, EmsValue::None, data[0], i % 8);
+		break;
+	    case EmsValue::Enumeration: {
+		EmsValue::Type enumType = (EmsValue::Type)
+			(EmsValue::WWSystemType + i % (EmsValue::FBTyp - EmsValue::WWSystemType + 1));
+		EmsValue::SubType subtype = i % 2 ? EmsValue::HK1 : EmsValue::WW;
+		samples.emplace_back(enumType, subtype, (uint8_t) (data[0] % 10));
+		break;
+	    }
+	    case EmsValue::Kennlinie:
+		samples.emplace_back(EmsValue::HKKennlinie, EmsValue::HK1, data[0], data[1], data[2]);
+		break;
+	    case EmsValue::Error: {
+		EmsValue::ErrorEntry entry;
+		memset(&entry, 0, sizeof(entry));
+		entry.type = 0x10 + i % 4;
+		entry.index = i % 20;
+		if (i % 5 != 0) {
+		    EmsProto::ErrorRecord& record = entry.record;
+		    record.errorAscii[0] = 'A' + data[0] % 26;
+		    record.errorAscii[1] = '0' + data[1] % 10;
+		    record.code_be16 = data[2] << 8 | data[3];
+		    record.durationMinutes_be16 = data[1];
+		    record.source = data[0];
+		    record.time.valid = i % 3 != 0;
+		    record.time.year = data[1] % 30;
+		    record.time.month = 1 + data[2] % 12;
+		    record.time.day = 1 + data[3] % 28;
+		    record.time.hour = data[0] % 24;
+		    record.time.minute = data[1] % 60;
+		}
+		samples.emplace_back(EmsValue::Fehler, EmsValue::None, entry);
+		break;
+	    }
+	    case EmsValue::Date: {
+		EmsProto::DateRecord record = { (uint8_t) (1 + data[0] % 28),
+						(uint8_t) (1 + data[1] % 12), (uint8_t) (data[2] % 30) };
+		samples.emplace_back(EmsValue::Wartungstermin, EmsValue::None, record);
+		break;
+	    }
+	    case EmsValue::SystemTime: {
+		EmsProto::SystemTimeRecord record;
+		memset(&record, 0, sizeof(record));
+		record.common.year = data[0] % 30;
+		record.common.month = 1 + data[1] % 12;
+		record.common.day = 1 + data[2] % 28;
+		record.common.hour = data[3] % 24;
+		record.common.minute = data[0] % 60;
+		record.second = data[1] % 60;
+		samples.emplace_back(EmsValue::SystemZeit, EmsValue::None, record);
+		break;
+	    }
+	    case EmsValue::Formatted:
+		samples.emplace_back(EmsValue::ServiceCode, EmsValue::None,
+				     TEXTS[i % (sizeof(TEXTS) / sizeof(TEXTS[0]))]);
+		break;
+	}
+    }
+}
+
+struct Result {
+    double nsPerValue;
+    double allocationsPerValue;
+};
+
+template<typename F> static Result
+measure(const std::vector<EmsValue>& samples, unsigned int iterations, F format)
+{
+    size_t length = 0;
+    unsigned long long startAllocations = allocationCount;
+    Clock::time_point start = Clock::now();
+
+    for (unsigned int i = 0; i < iterations; i++) {
+	for (auto& value : samples) {
+	    length += format(value);
+	}
+    }
+
+    Clock::duration time = Clock::now() - start;
+    double count = (double) iterations * samples.size();
+    volatile size_t sink = length;
+    (void) sink;
+
+    return Result {
+	std::chrono::duration<double, std::nano>(time).count() / count,
+	(allocationCount - startAllocations) / count
+    };
+}
+
+static void
+printResult(const char *name, const Result& result, bool last)
+{
+    std::cout << "\"" << name << "_ns\": " << result.nsPerValue << ", ";
+    std::cout << "\"" << name << "_allocations\": " << result.allocationsPerValue;
+    std::cout << (last ? " " : ", ");
+}
+
+static void
+usage(const char *programName)
+{
+    std::cerr << "Usage: " << programName << " [--iterations <n>]" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int iterations = 5000;
+
+    for (int i = 1; i < argc; i++) {
+	std::string arg = argv[i];
+	try {
+	    if (arg == "--iterations" && i + 1 < argc) {
+		iterations = boost::lexical_cast<unsigned int>(argv[++i]);
+	    } else {
+		usage(argv[0]);
+		return 1;
+	    }
+	} catch (boost::bad_lexical_cast& e) {
+	    usage(argv[0]);
+	    return 1;
+	}
+    }
+    if (iterations == 0) {
+	usage(argv[0]);
+	return 1;
+    }
+
+    static const EmsValue::ReadingType TYPES[] = {
+	EmsValue::Numeric, EmsValue::Integer, EmsValue::Boolean, EmsValue::Enumeration,
+	EmsValue::Kennlinie, EmsValue::Error, EmsValue::Date, EmsValue::SystemTime,
+	EmsValue::Formatted
+    };
+    const size_t typeCount = sizeof(TYPES) / sizeof(TYPES[0]);
+    unsigned int mismatches = 0;
+
+    std::cout << "{" << std::endl;
+    std::cout << "  \"iterations\": " << iterations << "," << std::endl;
+    std::cout << "  \"reading_types\": {" << std::endl;
+
+    for (size_t i = 0; i < typeCount; i++) {
+	std::vector<EmsValue> samples;
+	buildSamples(TYPES[i], samples);
+
+	char buffer[ValueApi::MaxFormattedLength];
+	for (auto& value : samples) {
+	    std::string expected = legacyFormatValue(value);
+	    std::string formatted(buffer, ValueApi::formatValue(value, buffer));
+	    if (formatted != expected || ValueApi::formatValue(value) != expected) {
+		std::cerr << readingTypeName(TYPES[i]) << ": expected '" << expected
+			  << "', got '" << formatted << "'" << std::endl;
+		mismatches++;
+	    }
+	}
+
+	Result legacy = measure(samples, iterations, [] (const EmsValue& value) {
+	    return legacyFormatValue(value).size();
+	});
+	Result buffered = measure(samples, iterations, [&buffer] (const EmsValue& value) {
+	    return ValueApi::formatValue(value, buffer);
+	});
+	Result string = measure(samples, iterations, [] (const EmsValue& value) {
+	    return ValueApi::formatValue(value).size();
+	});
+
+	std::cout << "    \"" << readingTypeName(TYPES[i]) << "\": { ";
+	printResult("legacy", legacy, false);
+	printResult("buffer", buffered, false);
+	printResult("string", string, true);
+	std::cout << "}" << (i + 1 < typeCount ? "," : "") << std::endl;
+    }
+
+    std::cout << "  }," << std::endl;
+    std::cout << "  \"mismatches\": " << mismatches << std::endl;
+    std::cout << "}" << std::endl;
+
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,59 @@
+/*
+ * Buderus EMS data collector
+ *
+ * Copyright (C) 2011 Danny Baumann <dannybaumann@web.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <iostream>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "ByteOrder.h"
+#include "FrameCapture.h"
+
+const char FrameCapture::Magic[4] = { 'E', 'M', 'S', 'C' };
+
+FrameCapture::FrameCapture(const std::string& path) :
+    m_file(path.c_str(), std::ios::out | std::ios::binary | std::ios::app)
+{
+    if (!m_file.is_open()) {
+	std::cerr << "Failed to open capture file " << path << std::endl;
+	return;
+    }
+
+    if (m_file.tellp() == 0) {
+	FileHeader header;
+	memcpy(header.magic, Magic, sizeof(header.magic));
+	header.version = CPU_TO_LE32(Version);
+	m_file.write((const char *) &header, sizeof(header));
+    }
+}
+
+void
+FrameCapture::write(const uint8_t *data, size_t length)
+{
+    static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+    boost::posix_time::time_duration now =
+	    boost::posix_time::microsec_clock::universal_time() - epoch;
+    RecordHeader header;
+
+    header.seconds = CPU_TO_LE32((uint32_t) now.total_seconds());
+    header.microseconds = CPU_TO_LE32((uint32_t) (now.total_microseconds() % 1000000));
+    header.length = (uint8_t) length;
+
+    m_file.write((const char *) &header, sizeof(header));
+    m_file.write((const char *) data, length);
+    m_file.flush();
+}
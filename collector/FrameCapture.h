@@ -0,0 +1,64 @@
+/*
+ * Buderus EMS data collector
+ *
+ * Copyright (C) 2011 Danny Baumann <dannybaumann@web.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FRAMECAPTURE_H__
+#define __FRAMECAPTURE_H__
+
+#include <fstream>
+#include <string>
+#include <stdint.h>
+
+/*
+ * Capture file layout: a FileHeader, followed by one RecordHeader plus
+ * <length> bytes of frame payload (source, dest, type, offset, data;
+ * without sync bytes, length and checksum) per received frame.
+ * All multi-byte fields are stored in little endian byte order.
+ */
+class FrameCapture
+{
+    public:
+#pragma pack(push,1)
+	typedef struct {
+	    char magic[4];
+	    uint32_t version;
+	} FileHeader;
+
+	typedef struct {
+	    uint32_t seconds;
+	    uint32_t microseconds;
+	    uint8_t length;
+	} RecordHeader;
+#pragma pack(pop)
+
+	static const char Magic[4];
+	static const uint32_t Version = 1;
+
+    public:
+	FrameCapture(const std::string& path);
+
+	bool isOpen() const {
+	    return m_file.is_open();
+	}
+	void write(const uint8_t *data, size_t length);
+
+    private:
+	std::ofstream m_file;
+};
+
+#endif /* __FRAMECAPTURE_H__ */
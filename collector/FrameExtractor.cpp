@@ -0,0 +1,135 @@
+/*
+ * Buderus EMS data collector
+ *
+ * Copyright (C) 2011 Danny Baumann <dannybaumann@web.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "FrameExtractor.h"
+#include "Options.h"
+
+FrameExtractor::FrameExtractor(FrameHandler handler) :
+    m_handler(handler),
+    m_carryLength(0),
+    m_checksumErrors(0)
+{
+}
+
+void
+FrameExtractor::feed(const uint8_t *data, size_t length)
+{
+    if (m_carryLength) {
+	size_t copied = std::min(length, sizeof(m_carry) - m_carryLength);
+	memcpy(m_carry + m_carryLength, data, copied);
+
+	size_t total = m_carryLength + copied;
+	size_t pending = scan(m_carry, total);
+
+	if (pending < m_carryLength) {
+	    /* The unfinished frame still starts in the old data. As the carry
+	     * buffer has room for a complete frame behind the old data, this
+	     * can only happen if all new data was copied. */
+	    m_carryLength = total - pending;
+	    memmove(m_carry, m_carry + pending, m_carryLength);
+	    return;
+	}
+
+	/* everything before the new data is done, continue with the
+	 * new data directly */
+	size_t skip = pending - m_carryLength;
+	m_carryLength = 0;
+	data += skip;
+	length -= skip;
+    }
+
+    size_t pending = scan(data, length);
+    m_carryLength = length - pending;
+    memcpy(m_carry, data + pending, m_carryLength);
+}
+
+/*
+ * Delivers all complete frames in the buffer and returns the position
+ * of the first byte belonging to a not yet complete frame (or the buffer
+ * length if there is none).
+ */
+size_t
+FrameExtractor::scan(const uint8_t *data, size_t length)
+{
+    size_t pos = 0;
+
+    while (pos < length) {
+	const uint8_t *sync = (const uint8_t *) memchr(data + pos, 0xaa, length - pos);
+	if (!sync) {
+	    return length;
+	}
+
+	size_t start = sync - data;
+	if (start + 1 < length && data[start + 1] != 0x55) {
+	    pos = start + 1;
+	    continue;
+	}
+	if (start + 3 > length) {
+	    /* sync or length byte not yet received */
+	    return start;
+	}
+
+	size_t payloadLength = data[start + 2];
+	if (start + 3 + payloadLength + 1 > length) {
+	    return start;
+	}
+
+	const uint8_t *payload = data + start + 3;
+	if (calcChecksum(payload, payloadLength) == payload[payloadLength]) {
+	    m_handler(payload, payloadLength);
+	    pos = start + 3 + payloadLength + 1;
+	} else {
+	    /* the sync bytes may have been part of the payload of another
+	     * frame, so rescan starting directly behind them */
+	    m_checksumErrors++;
+	    DebugStream& debug = Options::ioDebug();
+	    if (debug) {
+		debug << "IO: Checksum mismatch, resyncing" << std::endl;
+	    }
+	    pos = start + 1;
+	}
+    }
+
+    return length;
+}
+
+uint8_t
+FrameExtractor::calcChecksum(const uint8_t *data, size_t length)
+{
+    uint64_t wide = 0;
+    size_t pos = 0;
+
+    for (; pos + sizeof(wide) <= length; pos += sizeof(wide)) {
+	uint64_t word;
+	memcpy(&word, data + pos, sizeof(word));
+	wide ^= word;
+    }
+    wide ^= wide >> 32;
+    wide ^= wide >> 16;
+    wide ^= wide >> 8;
+
+    uint8_t checksum = wide & 0xff;
+    for (; pos < length; pos++) {
+	checksum ^= data[pos];
+    }
+
+    return checksum;
+}
@@ -0,0 +1,69 @@
+/*
+ * Buderus EMS data collector
+ *
+ * Copyright (C) 2011 Danny Baumann <dannybaumann@web.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FRAMEEXTRACTOR_H__
+#define __FRAMEEXTRACTOR_H__
+
+#include <cstddef>
+#include <stdint.h>
+#include <boost/function.hpp>
+
+/*
+ * Splits the raw byte stream coming from the bus interface into frames
+ * of the form 0xaa 0x55 <length> <payload> <xor checksum>.
+ *
+ * Frames which are completely contained in the buffer passed to feed()
+ * are delivered as views into that buffer without copying them. Only the
+ * unfinished frame at the end of a read is kept in an internal carry
+ * buffer until the next read completes it.
+ */
+class FrameExtractor
+{
+    public:
+	typedef boost::function<void (const uint8_t *data, size_t length)> FrameHandler;
+
+    public:
+	FrameExtractor(FrameHandler handler);
+
+	void feed(const uint8_t *data, size_t length);
+	void reset() {
+	    m_carryLength = 0;
+	}
+
+	unsigned long checksumErrors() const {
+	    return m_checksumErrors;
+	}
+
+    private:
+	size_t scan(const uint8_t *data, size_t length);
+	static uint8_t calcChecksum(const uint8_t *data, size_t length);
+
+    private:
+	/* sync (2) + length (1) + payload (max. 255) + checksum (1) */
+	static const size_t MaxFrameLength = 2 + 1 + 255 + 1;
+
+	FrameHandler m_handler;
+	/* carried bytes are always shorter than a frame, so the buffer
+	 * can hold them plus at least one complete frame from the next read */
+	uint8_t m_carry[2 * MaxFrameLength];
+	size_t m_carryLength;
+	unsigned long m_checksumErrors;
+};
+
+#endif /* __FRAMEEXTRACTOR_H__ */
@@ -0,0 +1,285 @@
+/*
+ * Buderus EMS data collector
+ *
+ * Copyright (C) 2011 Danny Baumann <dannybaumann@web.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include "HttpHandler.h"
+#include "ValueMetadata.h"
+
+HttpHandler::HttpHandler(boost::asio::io_service& ios,
+			 boost::asio::ip::tcp::endpoint& endpoint,
+			 ValueCache& cache, JsonSnapshot& snapshot,
+			 DataHandler& dataHandler) :
+    m_ios(ios),
+    m_cache(cache),
+    m_snapshot(snapshot),
+    m_dataHandler(dataHandler),
+    m_acceptor(ios, endpoint)
+{
+    startAccepting();
+}
+
+HttpHandler::~HttpHandler()
+{
+    m_acceptor.close();
+    std::for_each(m_connections.begin(), m_connections.end(),
+		  boost::bind(&HttpConnection::close, boost::placeholders::_1));
+    m_connections.clear();
+}
+
+void
+HttpHandler::handleAccept(HttpConnection::Ptr connection,
+			  const boost::system::error_code& error)
+{
+    if (error) {
+	if (error != boost::asio::error::operation_aborted) {
+	    std::cerr << "Accept error: " << error.message() << std::endl;
+	}
+	return;
+    }
+
+    startConnection(connection);
+    startAccepting();
+}
+
+void
+HttpHandler::startConnection(HttpConnection::Ptr connection)
+{
+    m_connections.insert(connection);
+    connection->startRead();
+}
+
+void
+HttpHandler::stopConnection(HttpConnection::Ptr connection)
+{
+    m_connections.erase(connection);
+    connection->close();
+}
+
+void
+HttpHandler::startAccepting()
+{
+    HttpConnection::Ptr connection(new HttpConnection(m_ios, *this));
+    m_acceptor.async_accept(connection->socket(),
+			    boost::bind(&HttpHandler::handleAccept, this,
+					connection, boost::asio::placeholders::error));
+}
+
+
+HttpConnection::HttpConnection(boost::asio::io_service& ios, HttpHandler& handler) :
+    m_ios(ios),
+    m_socket(ios),
+    m_request(MaxRequestSize),
+    m_handler(handler)
+{
+}
+
+/* splits the path of the target into decoded elements, ignoring the query */
+static bool
+splitPath(const std::string& target, std::vector<std::string>& elements)
+{
+    std::string element;
+
+    if (target.empty() || target[0] != '/') {
+	return false;
+    }
+
+    for (size_t pos = 1; pos < target.size() && target[pos] != '?'; pos++) {
+	char c = target[pos];
+	if (c == '/') {
+	    if (!element.empty()) {
+		elements.push_back(element);
+		element.clear();
+	    }
+	} else if (c == '%') {
+	    if (pos + 2 >= target.size() || !isxdigit(target[pos + 1]) || !isxdigit(target[pos + 2])) {
+		return false;
+	    }
+	    element += (char) strtoul(target.substr(pos + 1, 2).c_str(), NULL, 16);
+	    pos += 2;
+	} else {
+	    element += c;
+	}
+    }
+    if (!element.empty()) {
+	elements.push_back(element);
+    }
+
+    return true;
+}
+
+void
+HttpConnection::handleRequest(const boost::system::error_code& error)
+{
+    if (error) {
+	if (error != boost::asio::error::operation_aborted) {
+	    m_handler.stopConnection(shared_from_this());
+	}
+	return;
+    }
+
+    std::istream requestStream(&m_request);
+    std::string method, target, version, line, ifNoneMatch, lastEventId;
+    std::vector<std::string> path;
+
+    requestStream >> method >> target >> version;
+    if (!requestStream || version.compare(0, 5, "HTTP/") != 0 || !splitPath(target, path)) {
+	respond("400 Bad Request", "Bad request\n");
+	return;
+    }
+    std::getline(requestStream, line);
+    while (std::getline(requestStream, line) && line != "\r") {
+	size_t colon = line.find(':');
+	if (colon == std::string::npos) {
+	    continue;
+	}
+	std::string name = line.substr(0, colon);
+	if (boost::iequals(name, "If-None-Match")) {
+	    ifNoneMatch = line.substr(colon + 1);
+	} else if (boost::iequals(name, "Last-Event-ID")) {
+	    lastEventId = boost::trim_copy(line.substr(colon + 1));
+	}
+    }
+    if (method != "GET") {
+	respond("405 Method Not Allowed", "Only GET is supported\n");
+	return;
+    }
+
+    std::vector<std::string> selector;
+    if (!path.empty()) {
+	selector.assign(path.begin() + 1, path.end());
+    }
+
+    if (path.size() == 1 && path[0] == "values") {
+	respondSnapshot(ifNoneMatch);
+    } else if (path.size() >= 1 && path[0] == "values") {
+	std::ostringstream stream;
+	EmsValueMask mask;
+	if (!ValueMetadata::selectValues(selector, mask)) {
+	    respond("400 Bad Request", "Invalid selector\n");
+	    return;
+	}
+	m_handler.cache().outputJson(selector, stream);
+	respond("200 OK", stream.str(), "application/json");
+    } else if (path.size() >= 1 && path[0] == "events") {
+	startEvents(selector, lastEventId);
+    } else {
+	respond("404 Not Found", "Not found\n");
+    }
+}
+
+void
+HttpConnection::startEvents(const std::vector<std::string>& selector,
+			    const std::string& lastEventId)
+{
+    DataHandler& dataHandler = m_handler.dataHandler();
+    DataConnection::Ptr connection(
+	    new DataConnection(m_ios, dataHandler, DataConnection::Events));
+
+    if (!selector.empty() && !connection->subscribe(selector)) {
+	respond("400 Bad Request", "Invalid selector\n");
+	return;
+    }
+
+    /* the data handler takes over the socket for streaming the values */
+    connection->socket() = std::move(m_socket);
+    if (!lastEventId.empty()) {
+	/* a reconnecting client, which must not miss any values */
+	uint64_t since = 0;
+	bool valid = isdigit(lastEventId[0]);
+	try {
+	    since = boost::lexical_cast<uint64_t>(lastEventId);
+	} catch (boost::bad_lexical_cast& e) {
+	    valid = false;
+	}
+	if (!valid || !connection->queueResume(since)) {
+	    connection->queueSnapshot();
+	}
+    }
+    /* starts writing the queued values, too */
+    connection->sendText("HTTP/1.1 200 OK\r\n"
+			 "Content-Type: text/event-stream\r\n"
+			 "Cache-Control: no-cache\r\n"
+			 "Access-Control-Allow-Origin: *\r\n"
+			 "\r\n");
+    dataHandler.startConnection(connection);
+    m_handler.stopConnection(shared_from_this());
+}
+
+void
+HttpConnection::respond(const std::string& status, const std::string& body,
+			const std::string& contentType)
+{
+    m_body = body;
+    startWrite(status, "Content-Type: " + contentType + "\r\n", &m_body);
+}
+
+void
+HttpConnection::respondSnapshot(const std::string& ifNoneMatch)
+{
+    m_snapshot = m_handler.snapshot().current();
+
+    std::string headers = "ETag: " + m_snapshot->etag + "\r\n"
+			  "Cache-Control: no-cache\r\n";
+    /* a list of tags, weak ones compare equal to strong ones here */
+    if (ifNoneMatch.find(m_snapshot->etag) != std::string::npos ||
+	    boost::trim_copy(ifNoneMatch) == "*") {
+	startWrite("304 Not Modified", headers, NULL);
+	return;
+    }
+
+    headers += "Content-Type: application/json\r\n";
+    startWrite("200 OK", headers, &m_snapshot->body);
+}
+
+void
+HttpConnection::startWrite(const std::string& status, const std::string& headers,
+			   const std::string *body)
+{
+    std::ostringstream response;
+
+    response << "HTTP/1.1 " << status << "\r\n" << headers;
+    if (body) {
+	response << "Content-Length: " << body->size() << "\r\n";
+    }
+    response << "Access-Control-Allow-Origin: *\r\n";
+    response << "Connection: close\r\n\r\n";
+    m_response = response.str();
+
+    std::vector<boost::asio::const_buffer> buffers;
+    buffers.push_back(boost::asio::buffer(m_response));
+    if (body) {
+	buffers.push_back(boost::asio::buffer(*body));
+    }
+
+    boost::asio::async_write(m_socket, buffers,
+	boost::bind(&HttpConnection::handleWrite, shared_from_this(),
+		    boost::asio::placeholders::error));
+}
+
+void
+HttpConnection::handleWrite(const boost::system::error_code& error)
+{
+    if (error != boost::asio::error::operation_aborted) {
+	/* every connection serves a single request */
+	m_handler.stopConnection(shared_from_this());
+    }
+}
@@ -0,0 +1,128 @@
+/*
+ * Buderus EMS data collector
+ *
+ * Copyright (C) 2011 Danny Baumann <dannybaumann@web.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HTTPHANDLER_H__
+#define __HTTPHANDLER_H__
+
+#include <set>
+#include <boost/asio.hpp>
+#include <boost/bind/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include "DataHandler.h"
+#include "JsonSnapshot.h"
+#include "Noncopyable.h"
+#include "ValueCache.h"
+
+class HttpHandler;
+
+/*
+ * Minimal HTTP interface for web pages:
+ *   GET /values[/<selector>]  current cache contents as JSON, without
+ *                             selector from the JSON snapshot, with ETag
+ *   GET /events[/<selector>]  value changes as server-sent events, resumed
+ *                             after the Last-Event-ID if possible
+ * The selector uses the syntax of the cache command, one path element
+ * per word.
+ */
+class HttpConnection : public boost::enable_shared_from_this<HttpConnection>,
+		       private boost::noncopyable
+{
+    public:
+	typedef boost::shared_ptr<HttpConnection> Ptr;
+
+    public:
+	HttpConnection(boost::asio::io_service& ios, HttpHandler& handler);
+
+    public:
+	boost::asio::ip::tcp::socket& socket() {
+	    return m_socket;
+	}
+	void startRead() {
+	    boost::asio::async_read_until(m_socket, m_request, "\r\n\r\n",
+		boost::bind(&HttpConnection::handleRequest, shared_from_this(),
+			    boost::asio::placeholders::error));
+	}
+	void close() {
+	    m_socket.close();
+	}
+
+    private:
+	void handleRequest(const boost::system::error_code& error);
+	void handleWrite(const boost::system::error_code& error);
+	void respond(const std::string& status, const std::string& body,
+		     const std::string& contentType = "text/plain");
+	void respondSnapshot(const std::string& ifNoneMatch);
+	/* body must stay alive until the write finished, none if NULL */
+	void startWrite(const std::string& status, const std::string& headers,
+			const std::string *body);
+	void startEvents(const std::vector<std::string>& selector,
+			 const std::string& lastEventId);
+
+    private:
+	static const size_t MaxRequestSize = 8192;
+
+	boost::asio::io_service& m_ios;
+	boost::asio::ip::tcp::socket m_socket;
+	boost::asio::streambuf m_request;
+	std::string m_response;
+	std::string m_body;
+	/* sent instead of m_body, without copying it */
+	JsonSnapshot::Ptr m_snapshot;
+	HttpHandler& m_handler;
+};
+
+class HttpHandler : private boost::noncopyable
+{
+    public:
+	HttpHandler(boost::asio::io_service& ios,
+		    boost::asio::ip::tcp::endpoint& endpoint,
+		    ValueCache& cache, JsonSnapshot& snapshot,
+		    DataHandler& dataHandler);
+	~HttpHandler();
+
+    public:
+	void startConnection(HttpConnection::Ptr connection);
+	void stopConnection(HttpConnection::Ptr connection);
+
+	ValueCache& cache() {
+	    return m_cache;
+	}
+	JsonSnapshot& snapshot() {
+	    return m_snapshot;
+	}
+	/* event streams are passed on to it */
+	DataHandler& dataHandler() {
+	    return m_dataHandler;
+	}
+
+    private:
+	void handleAccept(HttpConnection::Ptr connection,
+			  const boost::system::error_code& error);
+	void startAccepting();
+
+    private:
+	boost::asio::io_service& m_ios;
+	ValueCache& m_cache;
+	JsonSnapshot& m_snapshot;
+	DataHandler& m_dataHandler;
+	boost::asio::ip::tcp::acceptor m_acceptor;
+	std::set<HttpConnection::Ptr> m_connections;
+};
+
+#endif /* __HTTPHANDLER_H__ */
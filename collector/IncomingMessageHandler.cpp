@@ -23,20 +23,39 @@
 #include "ByteOrder.h"
 #include "IncomingMessageHandler.h"
 #include "Options.h"
+#include "ValueMetadata.h"
 
-IncomingMessageHandler::IncomingMessageHandler(ValueCache& cache)
+IncomingMessageHandler::IncomingMessageHandler(ValueCache& cache) :
+    m_decodeMask(Options::dataDebug() ? EmsValueMask::all() : EmsMessage::lookupMask())
 {
-    m_valueCb = boost::bind(&IncomingMessageHandler::handleValue, this, boost::placeholders::_1);
-    m_cacheCb = [cache] (EmsValue::Type type, EmsValue::SubType subtype) {
+    m_cacheCb = [&cache] (EmsValue::Type type, EmsValue::SubType subtype) {
 	return cache.getValue(type, subtype);
     };
+    /* large enough for the biggest message */
+    m_values.reserve(64);
+    m_filteredValues.reserve(64);
+    m_envelopes.reserve(64);
+    m_filteredEnvelopes.reserve(64);
+    m_filteredIndices.reserve(64);
+    if (Options::resendInterval() > 0) {
+	m_shadow.reset(new PayloadShadow(Options::resendInterval()));
+    }
 }
 
 void
-IncomingMessageHandler::handleIncomingMessage(const std::vector<uint8_t>& data)
+IncomingMessageHandler::handleIncomingMessage(const uint8_t *data, size_t length)
 {
-    EmsMessage message(m_valueCb, m_cacheCb, data);
+    m_values.clear();
+
+    EmsMessage message(m_values, m_cacheCb, data, length, m_shadow.get(), &m_decodeMask);
     message.handle();
+    if (!m_values.empty()) {
+	m_envelopes.resize(m_values.size());
+	handleValues(EmsValueBatch(m_values.data(), m_values.size(), time(NULL),
+				   m_envelopes.data()));
+	/* sinks keep their own references to the envelopes they need */
+	m_envelopes.clear();
+    }
     if (message.getDestination() == EmsProto::addressPC) {
 	onPcMessageReceived(message);
     }
@@ -45,257 +64,9 @@ IncomingMessageHandler::handleIncomingMessage(const std::vector<uint8_t>& data)
 static void
 printDescriptive(std::ostream& stream, const EmsValue& value)
 {
-    static const std::map<EmsValue::Type, const char *> TYPEMAPPING = {
-	{ EmsValue::SollTemp, "Solltemperatur" },
-	{ EmsValue::IstTemp, "Isttemperatur" },
-	{ EmsValue::SetTemp, "Temperatureinstellung" },
-	{ EmsValue::MinTemp, "Minimale Temperatur" },
-	{ EmsValue::MaxTemp, "Maximale Temperatur" },
-	{ EmsValue::TagTemp, "Tagtemperatur" },
-	{ EmsValue::NachtTemp, "Nachttemperatur" },
-	{ EmsValue::UrlaubTemp, "Urlaubstemperatur" },
-	{ EmsValue::RaumSollTemp, "Raum-Solltemperatur" },
-	{ EmsValue::RaumIstTemp, "Raum-Isttemperatur" },
-	{ EmsValue::RaumEinfluss, "Max. Raumeinfluss" },
-	{ EmsValue::RaumOffset, "Raumoffset" },
-	{ EmsValue::SchwelleSommerWinter, "Schwelle Sommer/Winter" },
-	{ EmsValue::FrostSchutzTemp, "Frostschutztemperatur" },
-	{ EmsValue::AuslegungsTemp, "Auslegungstemperatur" },
-	{ EmsValue::RaumUebersteuerTemp, "Temporäre Raumtemperaturübersteuerung" },
-	{ EmsValue::AbsenkungsSchwellenTemp, "Schwellentemperatur Außenhaltbetrieb" },
-	{ EmsValue::UrlaubAbsenkungsSchwellenTemp, "Schwellentemperatur Außenhaltbetrieb Urlaub" },
-	{ EmsValue::AbsenkungsAbbruchTemp, "Nachtabsenkung abbrechen unterhalb" },
-	{ EmsValue::GedaempfteTemp, "Temperatur (gedämpft)" },
-	{ EmsValue::DesinfektionsTemp, "Desinfektionstemperatur" },
-	{ EmsValue::RaumTemperaturAenderung, "Raumtemperaturänderung" },
-	{ EmsValue::Mischersteuerung, "Mischersteuerung" },
-	{ EmsValue::Flammenstrom, "Flammenstrom" },
-	{ EmsValue::Systemdruck, "Systemdruck" },
-	{ EmsValue::BetriebsZeit, "Betriebszeit" },
-	{ EmsValue::BetriebsZeit, "Betriebszeit 2" },
-	{ EmsValue::SollModulation, "Sollwert Modulation" },
-	{ EmsValue::IstModulation, "Istwert Modulation" },
-	{ EmsValue::MinModulation, "Min. Modulation" },
-	{ EmsValue::MaxModulation, "Max. Modulation" },
-	{ EmsValue::EinschaltHysterese, "Einschalthysterese" },
-	{ EmsValue::AusschaltHysterese, "Abschalthysterese" },
-	{ EmsValue::DurchflussMenge, "Durchflussmenge" },
-	{ EmsValue::SollLeistung, "Angeforderte Leistung" },
-
-	{ EmsValue::HeizZeit, "Heizzeit" },
-	{ EmsValue::WarmwasserbereitungsZeit, "WW-Bereitungszeit" },
-	{ EmsValue::Brennerstarts, "Brennerstarts" },
-	{ EmsValue::WarmwasserBereitungen, "WW-Bereitungen " },
-	{ EmsValue::EinschaltoptimierungsZeit, "Einschaltoptimierungszeit" },
-	{ EmsValue::AusschaltoptimierungsZeit, "Abschaltoptimierungszeit" },
-	{ EmsValue::AntipendelZeit, "Antipendelzeit" },
-	{ EmsValue::NachlaufZeit, "Nachlaufzeit" },
-	{ EmsValue::DesinfektionStunde, "Thermische Desinfektion Stunde" },
-	{ EmsValue::HektoStundenVorWartung, "Wartungsintervall in 100h" },
-	{ EmsValue::PausenZeit, "restl. Pausenzeit" },
-	{ EmsValue::PartyZeit, "restl. Partyzeit" },
-
-	{ EmsValue::FlammeAktiv, "Flamme" },
-	{ EmsValue::BrennerAktiv, "Brenner" },
-	{ EmsValue::ZuendungAktiv, "Zündung" },
-	{ EmsValue::PumpeAktiv, "Pumpe" },
-	{ EmsValue::ZirkulationAktiv, "Zirkulation" },
-	{ EmsValue::DreiWegeVentilAufWW, "3-Wege-Ventil auf WW" },
-	{ EmsValue::EinmalLadungAktiv, "Einmalladung" },
-	{ EmsValue::DesinfektionAktiv, "Therm. Desinfektion" },
-	{ EmsValue::NachladungAktiv, "Nachladung" },
-	{ EmsValue::WarmwasserBereitung, "WW-Bereitung" },
-	{ EmsValue::WarmwasserTempOK, "WW-Temperatur OK" },
-	{ EmsValue::Tagbetrieb, "Tagbetrieb" },
-	{ EmsValue::Sommerbetrieb, "Sommerbetrieb" },
-	{ EmsValue::Ausschaltoptimierung, "Ausschaltoptimierung" },
-	{ EmsValue::Einschaltoptimierung, "Einschaltoptimierung" },
-	{ EmsValue::Estrichtrocknung, "Estrichtrocknung" },
-	{ EmsValue::WWVorrang, "WW-Vorrang" },
-	{ EmsValue::Ferien, "Ferienbetrieb" },
-	{ EmsValue::Urlaub, "Urlaubsbetrieb" },
-	{ EmsValue::Party, "Partybetrieb" },
-	{ EmsValue::Pause, "Pausebetrieb" },
-	{ EmsValue::Frostschutzbetrieb, "Frostschutzbetrieb" },
-	{ EmsValue::SchaltuhrEin, "Schaltuhr aktiv" },
-	{ EmsValue::KesselSchalter, "per Kesselschalter freigegeben" },
-	{ EmsValue::EigenesProgrammAktiv, "Eigenes Programm aktiv" },
-	{ EmsValue::EinmalLadungsLED, "Einmalladungs-LED" },
-	{ EmsValue::Desinfektion, "Thermische Desinfektion" },
-	{ EmsValue::ATDaempfung, "Dämpfung Außentemperatur" },
-	{ EmsValue::SchaltzeitOptimierung, "Schaltzeitoptimierung" },
-	{ EmsValue::Fuehler1Defekt, "Fühler 1 defekt" },
-	{ EmsValue::Fuehler2Defekt, "Fühler 2 defekt" },
-	{ EmsValue::Stoerung, "Störung" },
-	{ EmsValue::StoerungDesinfektion, "Störung Desinfektion" },
-	{ EmsValue::Ladevorgang, "Ladevorgang" },
-
-	{ EmsValue::WWSystemType, "WW-System-Typ" },
-	{ EmsValue::Betriebsart, "Betriebsart" },
-	{ EmsValue::Wartungsmeldungen, "Wartungsmeldungen" },
-	{ EmsValue::WartungFaellig, "Wartung fällig?" },
-	{ EmsValue::DesinfektionTag, "Thermische Desinfektion Tag" },
-	{ EmsValue::Schaltpunkte, "Schaltpunkte" },
-	{ EmsValue::GebaeudeArt, "Gebäudeart" },
-	{ EmsValue::AbsenkModus, "Absenk-Modus" },
-	{ EmsValue::HeizSystem, "Heizsystem" },
-	{ EmsValue::FuehrungsGroesse, "Führungsgröße" },
-	{ EmsValue::Frostschutz, "Frostschutz" },
-	{ EmsValue::UrlaubAbsenkungsArt, "Urlaubsabsenkungsart" },
-	{ EmsValue::FBTyp, "Fernbedienungstyp" },
-
-	{ EmsValue::HKKennlinie, "Kennlinie" },
-	{ EmsValue::Fehler, "Fehler" },
-	{ EmsValue::SystemZeit, "Systemzeit" },
-	{ EmsValue::Wartungstermin, "Wartungstermin" },
-
-	{ EmsValue::ServiceCode, "Servicecode" },
-	{ EmsValue::FehlerCode, "Fehlercode" }
-    };
-    static const std::map<EmsValue::SubType, const char *> SUBTYPEMAPPING = {
-	{ EmsValue::HK1, "HK1" },
-	{ EmsValue::HK2, "HK2" },
-	{ EmsValue::HK3, "HK3" },
-	{ EmsValue::HK4, "HK4" },
-	{ EmsValue::Kessel, "Kessel" },
-	{ EmsValue::Brenner, "Brenner" },
-	{ EmsValue::KesselPumpe, "Kesselpumpe" },
-	{ EmsValue::Ruecklauf, "Rücklauf" },
-	{ EmsValue::Waermetauscher, "Wärmetauscher" },
-	{ EmsValue::WW, "Warmwasser" },
-	{ EmsValue::Zirkulation, "Zirkulation" },
-	{ EmsValue::Aussen, "Außen" },
-	{ EmsValue::Abgas, "Abgas" },
-	{ EmsValue::Ansaugluft, "Ansaugluft" },
-	{ EmsValue::Solar, "Solar" },
-	{ EmsValue::SolarSpeicher, "Solarspeicher" },
-	{ EmsValue::SolarKollektor, "Solarkollektor" }
-    };
-    static const std::map<EmsValue::Type, const char *> UNITMAPPING = {
-	{ EmsValue::SollTemp, "°C" },
-	{ EmsValue::IstTemp, "°C" },
-	{ EmsValue::SetTemp, "°C" },
-	{ EmsValue::MinTemp, "°C" },
-	{ EmsValue::MaxTemp, "°C" },
-	{ EmsValue::TagTemp, "°C" },
-	{ EmsValue::NachtTemp, "°C" },
-	{ EmsValue::UrlaubTemp, "°C" },
-	{ EmsValue::RaumSollTemp, "°C" },
-	{ EmsValue::RaumIstTemp, "°C" },
-	{ EmsValue::RaumEinfluss, "K" },
-	{ EmsValue::RaumOffset, "K" },
-	{ EmsValue::SchwelleSommerWinter, "°C" },
-	{ EmsValue::FrostSchutzTemp, "°C" },
-	{ EmsValue::AuslegungsTemp, "°C" },
-	{ EmsValue::RaumUebersteuerTemp, "°C" },
-	{ EmsValue::AbsenkungsSchwellenTemp, "°C" },
-	{ EmsValue::UrlaubAbsenkungsSchwellenTemp, "°C" },
-	{ EmsValue::AbsenkungsAbbruchTemp, "°C" },
-	{ EmsValue::GedaempfteTemp, "°C" },
-	{ EmsValue::DesinfektionsTemp, "°C" },
-	{ EmsValue::RaumTemperaturAenderung, "K/min" },
-	{ EmsValue::EinschaltHysterese, "K" },
-	{ EmsValue::AusschaltHysterese, "K" },
-	{ EmsValue::DurchflussMenge, "l/min" },
-	{ EmsValue::IstModulation, "%" },
-	{ EmsValue::SollModulation, "%" },
-	{ EmsValue::MinModulation, "%" },
-	{ EmsValue::MaxModulation, "%" },
-	{ EmsValue::SollLeistung, "%" },
-	{ EmsValue::Flammenstrom, "µA" },
-	{ EmsValue::Systemdruck, "bar" },
-	{ EmsValue::BetriebsZeit, "min" },
-	{ EmsValue::BetriebsZeit2, "min" },
-	{ EmsValue::HeizZeit, "min" },
-	{ EmsValue::WarmwasserbereitungsZeit, "min" },
-	{ EmsValue::EinschaltoptimierungsZeit, "min" },
-	{ EmsValue::AusschaltoptimierungsZeit, "min" },
-	{ EmsValue::AntipendelZeit, "min" },
-	{ EmsValue::NachlaufZeit, "min" },
-	{ EmsValue::DesinfektionStunde, "h" },
-	{ EmsValue::PausenZeit, "h" },
-	{ EmsValue::PartyZeit, "h" }
-    };
-
-    static const std::map<uint8_t, const char *> WWSYSTEMMAPPING = {
-	{ EmsProto::WWSystemNone, "keins" },
-	{ EmsProto::WWSystemDurchlauf, "Durchlauferhitzer" },
-	{ EmsProto::WWSystemKlein, "klein" },
-	{ EmsProto::WWSystemGross, "groß" },
-	{ EmsProto::WWSystemSpeicherlade, "Speicherladesystem" }
-    };
-
-    static const std::map<uint8_t, const char *> ZIRKSPMAPPING = {
-	{ 0, "aus" },
-	{ 1, "1x 3min" }, { 2, "2x 3min" }, { 3, "3x 3min" },
-	{ 4, "4x 3min" }, { 5, "5x 3min" }, { 6, "6x 3min" },
-	{ 7, "dauerhaft an" }
-    };
-
-    static const std::map<uint8_t, const char *> MAINTENANCEMESSAGESMAPPING = {
-	{ 0, "keine" },
-	{ 1, "nach Betriebsstunden" },
-	{ 2, "nach Datum" }
-    };
-
-    static const std::map<uint8_t, const char *> MAINTENANCENEEDEDMAPPING = {
-	{ 0, "nein" },
-	{ 3, "ja, wegen Betriebsstunden" },
-	{ 8, "ja, wegen Datum" }
-    };
-
-    static const std::map<uint8_t, const char *> ERRORTYPEMAPPING = {
-	{ 0x10, "Verriegelnder Fehler" },
-	{ 0x11, "Blockierender Fehler" },
-	{ 0x12, "Anlagenfehler" },
-	{ 0x13, "Zurückgesetzter Anlagenfehler" }
-    };
-
-    static const std::map<uint8_t, const char *> WEEKDAYMAPPING = {
-	{ 0, "Montag" }, { 1, "Dienstag" }, { 2, "Mittwoch" }, { 3, "Donnerstag" },
-	{ 4, "Freitag" }, { 5, "Samstag" }, { 6, "Sonntag" }
-    };
-
-    static const std::map<uint8_t, const char *> OPMODEMAPPING = {
-	{ 0, "ständig aus" }, { 1, "ständig an" }, { 2, "Automatik" }
-    };
-
-    static const std::map<uint8_t, const char *> HKOPMODEMAPPING = {
-	{ 0, "immer Nachtbetrieb" }, { 1, "immer Tagbetrieb" }, { 2, "Automatik" }
-    };
-
-    static const std::map<uint8_t, const char *> BUILDINGTYPEMAPPING = {
-	{ 0, "leicht" }, { 1, "mittel" }, { 2, "schwer" }
-    };
-
-    static const std::map<uint8_t, const char *> HEATINGTYPEMAPPING = {
-	{ 1, "Heizkörper" }, { 2, "Konvektor" }, { 3, "Fußboden" },
-    };
-
-    static const std::map<uint8_t, const char *> REDUCTIONMODEMAPPING = {
-	{ 0, "Abschalt" }, { 1, "Reduziert" }, { 2, "Raumhalt" }, { 3, "Außenhalt" }
-    };
-
-    static const std::map<uint8_t, const char *> FROSTPROTECTMAPPING = {
-	{ 0, "kein" }, { 1, "Außentemperatur" }, { 2, "Raumtemperatur 5 Grad" }
-    };
-
-    static const std::map<uint8_t, const char *> RELEVANTVALUEMAPPING = {
-	{ 0, "außentemperaturgeführt" }, { 1, "raumtemperaturgeführt" }
-    };
-
-    static const std::map<uint8_t, const char *> VACATIONREDUCTIONMAPPING = {
-	{ 3, "Außenhalt" }, { 2, "Raumhalt" }
-    };
-
-    static const std::map<uint8_t, const char *> REMOTETYPEMAPPING = {
-	{ 0, "Keine" }, { 1, "RC20" }, { 2, "RC3x" }
-    };
-
-    auto typeIter = TYPEMAPPING.find(value.getType());
-    const char *type = typeIter != TYPEMAPPING.end() ? typeIter->second : NULL;
-    auto subtypeIter = SUBTYPEMAPPING.find(value.getSubType());
-    const char *subtype = subtypeIter != SUBTYPEMAPPING.end() ? subtypeIter->second : NULL;
+    const ValueMetadata::TypeInfo& typeInfo = ValueMetadata::type(value.getType());
+    const char *type = typeInfo.description;
+    const char *subtype = ValueMetadata::subType(value.getSubType()).description;
 
     if (subtype) {
 	stream << subtype;
@@ -319,9 +90,8 @@ printDescriptive(std::ostream& stream, const EmsValue& value)
 		} else {
 		    stream << value.getValue<unsigned int>();
 		}
-		auto unitIter = UNITMAPPING.find(value.getType());
-		if (unitIter != UNITMAPPING.end()) {
-		    stream << " " << unitIter->second;
+		if (typeInfo.unit) {
+		    stream << " " << typeInfo.unit;
 		}
 	    } else {
 		stream << "nicht verfügbar";
@@ -332,35 +102,18 @@ printDescriptive(std::ostream& stream, const EmsValue& value)
 	    stream << (value.getValue<bool>() ? "AN" : "AUS");
 	    break;
 	case EmsValue::Enumeration: {
-	    const std::map<uint8_t, const char *> *map = NULL;
 	    uint8_t enumValue = value.getValue<uint8_t>();
-	    switch (value.getType()) {
-		case EmsValue::WWSystemType: map = &WWSYSTEMMAPPING; break;
-		case EmsValue::Schaltpunkte: map = &ZIRKSPMAPPING; break;
-		case EmsValue::Wartungsmeldungen: map = &MAINTENANCEMESSAGESMAPPING; break;
-		case EmsValue::WartungFaellig: map = &MAINTENANCENEEDEDMAPPING; break;
-		case EmsValue::Betriebsart:
-		    map = value.isForHK() ? &HKOPMODEMAPPING : &OPMODEMAPPING;
-		    break;
-		case EmsValue::DesinfektionTag: map = &WEEKDAYMAPPING; break;
-		case EmsValue::GebaeudeArt: map = &BUILDINGTYPEMAPPING; break;
-		case EmsValue::HeizSystem: map = &HEATINGTYPEMAPPING; break;
-		case EmsValue::AbsenkModus: map = &REDUCTIONMODEMAPPING; break;
-		case EmsValue::FBTyp: map = &REMOTETYPEMAPPING; break;
-		case EmsValue::Frostschutz: map = &FROSTPROTECTMAPPING; break;
-		case EmsValue::FuehrungsGroesse: map = &RELEVANTVALUEMAPPING; break;
-		case EmsValue::UrlaubAbsenkungsArt: map = &VACATIONREDUCTIONMAPPING; break;
-		default: break;
-	    }
-	    if (map && map->find(enumValue) != map->end()) {
-		stream << map->at(enumValue);
+	    const ValueMetadata::EnumLabel *label =
+		    ValueMetadata::findLabel(ValueMetadata::labels(value), enumValue);
+	    if (label && label->description) {
+		stream << label->description;
 	    } else {
 		stream << "??? (" << (unsigned int) enumValue << ")";
 	    }
 	    break;
 	}
 	case EmsValue::Kennlinie: {
-	    std::vector<uint8_t> kennlinie = value.getValue<std::vector<uint8_t> >();
+	    EmsValue::KennlinieRecord kennlinie = value.getValue<EmsValue::KennlinieRecord>();
 	    stream << boost::format("-10 °C: %d °C / 0 °C: %d °C / 10 °C: %d °C")
 		    % (unsigned int) kennlinie[0] % (unsigned int) kennlinie[1]
 		    % (unsigned int) kennlinie[2];
@@ -369,7 +122,9 @@ printDescriptive(std::ostream& stream, const EmsValue& value)
 	case EmsValue::Error: {
 	    EmsValue::ErrorEntry entry = value.getValue<EmsValue::ErrorEntry>();
 	    EmsProto::ErrorRecord& record = entry.record;
-	    stream << ERRORTYPEMAPPING.at(entry.type) << " " << entry.index << ": ";
+	    const ValueMetadata::EnumLabel *label =
+		    ValueMetadata::findLabel(ValueMetadata::labels(value), entry.type);
+	    stream << (label ? label->description : "???") << " " << entry.index << ": ";
 	    if (record.errorAscii[0] == 0) {
 		stream << "Leer" << std::endl;
 	    } else {
@@ -398,14 +153,15 @@ printDescriptive(std::ostream& stream, const EmsValue& value)
 	}
 	case EmsValue::SystemTime: {
 	    EmsProto::SystemTimeRecord record = value.getValue<EmsProto::SystemTimeRecord>();
-	    auto dayIter = WEEKDAYMAPPING.find(record.dayOfWeek);
+	    const ValueMetadata::EnumLabel *day =
+		    ValueMetadata::findLabel(ValueMetadata::WEEKDAYS, record.dayOfWeek);
 
 	    stream << boost::format("%d.%d.%d")
 		    % (unsigned int) record.common.day % (unsigned int) record.common.month
 		    % (2000 + record.common.year);
 
-	    if (dayIter != WEEKDAYMAPPING.end()) {
-		stream << " (" << dayIter->second << ")";
+	    if (day && day->description) {
+		stream << " (" << day->description << ")";
 	    }
 	    stream << ", " << boost::format("%d:%02d:%02d")
 		    % (unsigned int) record.common.hour % (unsigned int) record.common.minute
@@ -438,14 +194,43 @@ printDescriptive(std::ostream& stream, const EmsValue& value)
 }
 
 void
-IncomingMessageHandler::handleValue(const EmsValue& value)
+IncomingMessageHandler::handleValues(const EmsValueBatch& values)
 {
     if (Options::dataDebug()) {
-	Options::dataDebug() << "DATA: ";
-	printDescriptive(Options::dataDebug(), value);
-	Options::dataDebug() << std::endl;
+	for (auto& value : values) {
+	    Options::dataDebug() << "DATA: ";
+	    printDescriptive(Options::dataDebug(), value);
+	    Options::dataDebug() << std::endl;
+	}
     }
-    for (auto& cb : m_valueCallbacks) {
-	cb(value);
+    for (auto& sink : m_valueCallbacks) {
+	if (sink.mask.isAll()) {
+	    sink.callback(values);
+	    continue;
+	}
+
+	m_filteredValues.clear();
+	m_filteredIndices.clear();
+	for (size_t i = 0; i < values.size(); i++) {
+	    const EmsValue& value = values.begin()[i];
+	    if (sink.mask.test(value.getType(), value.getSubType())) {
+		m_filteredValues.push_back(value);
+		m_filteredIndices.push_back(i);
+	    }
+	}
+	if (m_filteredValues.empty()) {
+	    continue;
+	}
+
+	m_filteredEnvelopes.clear();
+	for (auto index : m_filteredIndices) {
+	    m_filteredEnvelopes.push_back(values.envelopes()[index]);
+	}
+	sink.callback(EmsValueBatch(m_filteredValues.data(), m_filteredValues.size(),
+				    values.timestamp(), m_filteredEnvelopes.data()));
+	/* pass envelopes created by this sink on to the following ones */
+	for (size_t i = 0; i < m_filteredIndices.size(); i++) {
+	    values.envelopes()[m_filteredIndices[i]].swap(m_filteredEnvelopes[i]);
+	}
     }
 }
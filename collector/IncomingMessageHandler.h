@@ -24,30 +24,51 @@
 #include <boost/asio.hpp>
 #include <boost/bind/bind.hpp>
 #include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
 #include "EmsMessage.h"
 #include "ValueCache.h"
 
 class IncomingMessageHandler
 {
     public:
-	typedef std::function<void (const EmsValue& value)> ValueCallback;
+	typedef std::function<void (const EmsValueBatch& values)> ValueCallback;
 
     public:
 	IncomingMessageHandler(ValueCache& cache);
 
-	void addValueCallback(ValueCallback& cb) {
-	    m_valueCallbacks.push_back(cb);
+	void addValueCallback(ValueCallback& cb, const EmsValueMask& mask = EmsValueMask::all()) {
+	    m_valueCallbacks.push_back(ValueSink(cb, mask));
+	    m_decodeMask |= mask;
 	}
 
-	void handleIncomingMessage(const std::vector<uint8_t>& data);
+	void handleIncomingMessage(const uint8_t *data, size_t length);
+	void handleIncomingMessage(const std::vector<uint8_t>& data) {
+	    handleIncomingMessage(data.data(), data.size());
+	}
 	virtual void onPcMessageReceived(const EmsMessage& /* message */) {}
 
     private:
-	void handleValue(const EmsValue& value);
+	void handleValues(const EmsValueBatch& values);
+
+	struct ValueSink {
+	    ValueCallback callback;
+	    EmsValueMask mask;
+
+	    ValueSink(ValueCallback& cb, const EmsValueMask& m) :
+		callback(cb), mask(m) { }
+	};
 
-	std::list<ValueCallback> m_valueCallbacks;
-	EmsMessage::ValueHandler m_valueCb;
+	std::list<ValueSink> m_valueCallbacks;
+	/* union of the sink masks, fields outside of it aren't decoded */
+	EmsValueMask m_decodeMask;
+	EmsMessage::ValueBuffer m_values;
+	EmsMessage::ValueBuffer m_filteredValues;
+	/* envelopes of m_values, created by the first sink needing them */
+	std::vector<EmsValueBatch::EnvelopePtr> m_envelopes;
+	std::vector<EmsValueBatch::EnvelopePtr> m_filteredEnvelopes;
+	std::vector<size_t> m_filteredIndices;
 	EmsMessage::CacheAccessor m_cacheCb;
+	boost::scoped_ptr<PayloadShadow> m_shadow;
 };
 
 #endif /* __INCOMINGMESSAGEANDLER_H__ */
@@ -0,0 +1,462 @@
+/*
+ * Buderus EMS data collector
+ *
+ * Copyright (C) 2011 Danny Baumann <dannybaumann@web.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * End-to-end ingest benchmark: drives a telegram stream (either a file
+ * recorded with --capture-file or a built-in synthetic one) through
+ * FrameExtractor, EmsMessage, ValueCache, DataHandler and stand-ins for
+ * the MQTT and database value callbacks, and prints the results as JSON.
+ *
+ * Build with 'make benchmark', run as
+ *   ./ingest-benchmark [--iterations <n>] [--chunk-size <n>] [--data-clients <n>]
+ *                      [capture file]
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <random>
+#include <boost/lexical_cast.hpp>
+#include "DataHandler.h"
+#include "FrameCapture.h"
+#include "FrameExtractor.h"
+#include "IoHandler.h"
+#include "ValueCache.h"
+#include "ValueEnvelope.h"
+
+static unsigned long long allocationCount = 0;
+
+/* keep the replacements out of line, gcc otherwise complains about
+ * free() being called on memory from operator new */
+void * __attribute__((noinline))
+operator new(size_t size)
+{
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+	throw std::bad_alloc();
+    }
+    allocationCount++;
+    return p;
+}
+
+void __attribute__((noinline))
+operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+typedef std::chrono::steady_clock Clock;
+
+struct Stage {
+    const char *name;
+    Clock::duration time;
+    unsigned long long allocations;
+
+    Stage(const char *n) :
+	name(n), time(Clock::duration::zero()), allocations(0) { }
+};
+
+class StageTimer {
+    public:
+	StageTimer(Stage& stage) :
+	    m_stage(stage),
+	    m_start(Clock::now()),
+	    m_allocations(allocationCount)
+	{ }
+	~StageTimer() {
+	    m_stage.time += Clock::now() - m_start;
+	    m_stage.allocations += allocationCount - m_allocations;
+	}
+
+    private:
+	Stage& m_stage;
+	Clock::time_point m_start;
+	unsigned long long m_allocations;
+};
+
+/* feeds the stream like IoHandler::readComplete() does, but with timers
+ * around the extraction and around the handling of the extracted frames */
+class BenchmarkHandler : public IoHandler
+{
+    public:
+	BenchmarkHandler(ValueCache& cache, Stage& feedStage, Stage& frameStage) :
+	    IoHandler(cache, false),
+	    m_extractor(boost::bind(&BenchmarkHandler::handleFrame, this,
+				    boost::placeholders::_1, boost::placeholders::_2)),
+	    m_feedStage(feedStage),
+	    m_frameStage(frameStage)
+	{ }
+
+	void feed(const uint8_t *data, size_t length, size_t chunkSize) {
+	    while (length > 0) {
+		size_t chunk = std::min(length, chunkSize);
+		{
+		    StageTimer t(m_feedStage);
+		    m_extractor.feed(data, chunk);
+		}
+		data += chunk;
+		length -= chunk;
+	    }
+	}
+
+	static size_t maxChunkSize() {
+	    return maxReadLength;
+	}
+
+    protected:
+	virtual void readStart() { }
+	virtual void doCloseImpl() { }
+
+    private:
+	void handleFrame(const uint8_t *data, size_t length) {
+	    StageTimer t(m_frameStage);
+	    handleIncomingMessage(data, length);
+	}
+
+    private:
+	FrameExtractor m_extractor;
+	Stage& m_feedStage;
+	Stage& m_frameStage;
+};
+
+/* what MqttAdapter::handleValues() does, minus the publishing */
+static void
+mqttStub(const EmsValueBatch& values)
+{
+    const std::string prefix = "/ems/";
+
+    std::string topic;
+
+    for (size_t i = 0; i < values.size(); i++) {
+	ValueEnvelope::Ptr envelope = ValueEnvelope::get(values, i);
+	boost::string_ref suffix = envelope->topic();
+
+	topic.assign(prefix);
+	topic.append(suffix.data(), suffix.size());
+	std::string formattedValue = envelope->value().to_string();
+	volatile size_t sink = topic.size() + formattedValue.size();
+	(void) sink;
+    }
+}
+
+/* what Database::handleValues() does, minus the SQL statements */
+static void
+dbStub(const EmsValueBatch& values)
+{
+    volatile float sink = 0;
+
+    for (auto& value : values) {
+	if (!value.isValid()) {
+	    continue;
+	}
+
+	switch (value.getReadingType()) {
+	    case EmsValue::Numeric: sink = value.getValue<float>(); break;
+	    case EmsValue::Integer: sink = value.getValue<unsigned int>(); break;
+	    case EmsValue::Boolean: sink = value.getValue<bool>(); break;
+	    case EmsValue::Enumeration: sink = value.getValue<uint8_t>(); break;
+	    default: break;
+	}
+    }
+    (void) sink;
+}
+
+static void
+appendFrame(std::vector<uint8_t>& stream, const uint8_t *payload, size_t length)
+{
+    uint8_t checksum = 0;
+
+    stream.push_back(0xaa);
+    stream.push_back(0x55);
+    stream.push_back(length);
+    for (size_t i = 0; i < length; i++) {
+	stream.push_back(payload[i]);
+	checksum ^= payload[i];
+    }
+    stream.push_back(checksum);
+}
+
+static bool
+loadCaptureFile(const std::string& path, std::vector<uint8_t>& stream, size_t& frames)
+{
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)),
+				  std::istreambuf_iterator<char>());
+    FrameCapture::FileHeader header;
+
+    if (!file.is_open() || contents.size() < sizeof(header)) {
+	std::cerr << "Could not read capture file " << path << std::endl;
+	return false;
+    }
+    memcpy(&header, contents.data(), sizeof(header));
+    if (memcmp(header.magic, FrameCapture::Magic, sizeof(header.magic)) != 0) {
+	std::cerr << path << " is not a valid capture file." << std::endl;
+	return false;
+    }
+
+    size_t pos = sizeof(header);
+    while (pos + sizeof(FrameCapture::RecordHeader) <= contents.size()) {
+	FrameCapture::RecordHeader record;
+	memcpy(&record, contents.data() + pos, sizeof(record));
+	pos += sizeof(record);
+	if (pos + record.length > contents.size()) {
+	    break;
+	}
+	appendFrame(stream, contents.data() + pos, record.length);
+	pos += record.length;
+	frames++;
+    }
+
+    return true;
+}
+
+/* roughly the message mix of a UBA + RC35 + SM10 system; like on a real
+ * bus, consecutive broadcasts of a message differ in only a few bytes */
+static void
+buildSyntheticStream(std::vector<uint8_t>& stream, size_t& frames)
+{
+    static const struct {
+	uint8_t source, dest, type, length;
+	unsigned int count;
+    } MESSAGES[] = {
+	{ EmsProto::addressUBA, 0x00, 0x18, 25, 20 },
+	{ EmsProto::addressUBA, 0x00, 0x19, 25, 4 },
+	{ EmsProto::addressUBA, 0x00, 0x34, 18, 4 },
+	{ EmsProto::addressUBA, 0x00, 0x14, 3, 1 },
+	{ EmsProto::addressUBA, 0x00, 0x1C, 8, 1 },
+	{ EmsProto::addressUBA, 0x00, 0x16, 20, 1 },
+	{ EmsProto::addressUBA, 0x00, 0x33, 11, 1 },
+	{ EmsProto::addressRC3x, 0x00, 0x06, 8, 2 },
+	{ EmsProto::addressRC3x, 0x00, 0x3E, 15, 4 },
+	{ EmsProto::addressRC3x, 0x00, 0x48, 15, 4 },
+	{ EmsProto::addressRC3x, 0x00, 0x3D, 42, 1 },
+	{ EmsProto::addressRC3x, 0x00, 0xA3, 6, 2 },
+	{ EmsProto::addressRC3x, 0x00, 0x37, 12, 1 },
+	{ EmsProto::addressSM10, 0x00, 0x97, 9, 4 },
+	{ EmsProto::addressMM10HK1, 0x00, 0xAB, 6, 4 }
+    };
+    std::mt19937 random(4711);
+
+    for (auto& message : MESSAGES) {
+	uint8_t payload[4 + 255] = { message.source, message.dest, message.type, 0 };
+	for (size_t j = 0; j < message.length; j++) {
+	    payload[4 + j] = random() & 0xff;
+	}
+	for (unsigned int i = 0; i < message.count; i++) {
+	    unsigned int changes = random() % 3;
+	    for (unsigned int j = 0; j < changes; j++) {
+		payload[4 + random() % message.length] = random() & 0xff;
+	    }
+	    appendFrame(stream, payload, 4 + message.length);
+	    frames++;
+	}
+    }
+}
+
+static void
+printStage(const Stage& stage, size_t frames, bool last)
+{
+    std::cout << "    \"" << stage.name << "\": { "
+	      << "\"ns_per_frame\": "
+	      << std::chrono::duration<double, std::nano>(stage.time).count() / frames << ", "
+	      << "\"allocations_per_frame\": " << (double) stage.allocations / frames
+	      << " }" << (last ? "" : ",") << std::endl;
+}
+
+static void
+usage(const char *name)
+{
+    std::cerr << "Usage: " << name
+	      << " [--iterations <n>] [--chunk-size <n>] [--data-clients <n>] [capture file]"
+	      << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int iterations = 200;
+    size_t chunkSize = 64;
+    unsigned int dataClients = 1;
+    std::string captureFile;
+
+    for (int i = 1; i < argc; i++) {
+	std::string arg = argv[i];
+	try {
+	    if (arg == "--iterations" && i + 1 < argc) {
+		iterations = boost::lexical_cast<unsigned int>(argv[++i]);
+	    } else if (arg == "--chunk-size" && i + 1 < argc) {
+		chunkSize = boost::lexical_cast<size_t>(argv[++i]);
+	    } else if (arg == "--data-clients" && i + 1 < argc) {
+		dataClients = boost::lexical_cast<unsigned int>(argv[++i]);
+	    } else if (arg[0] != '-' && captureFile.empty()) {
+		captureFile = arg;
+	    } else {
+		usage(argv[0]);
+		return 1;
+	    }
+	} catch (boost::bad_lexical_cast& e) {
+	    usage(argv[0]);
+	    return 1;
+	}
+    }
+    if (iterations == 0 || chunkSize == 0 || chunkSize > BenchmarkHandler::maxChunkSize()) {
+	usage(argv[0]);
+	return 1;
+    }
+
+    std::vector<uint8_t> stream;
+    size_t framesPerIteration = 0;
+    if (!captureFile.empty()) {
+	if (!loadCaptureFile(captureFile, stream, framesPerIteration)) {
+	    return 1;
+	}
+    } else {
+	buildSyntheticStream(stream, framesPerIteration);
+    }
+    if (framesPerIteration == 0) {
+	std::cerr << "No frames to replay." << std::endl;
+	return 1;
+    }
+
+    /* feed contains frame, which contains the value callbacks */
+    Stage feedStage("feed"), frameStage("frame"), pollStage("poll");
+    Stage extractStage("extract"), decodeStage("decode"), cacheStage("cache");
+    Stage dataStage("data"), mqttStage("mqtt"), dbStage("db");
+    ValueCache cache;
+    BenchmarkHandler handler(cache, feedStage, frameStage);
+    unsigned long long values = 0;
+
+    IoHandler::ValueCallback cacheCb = [&] (const EmsValueBatch& batch) {
+	StageTimer t(cacheStage);
+	values += batch.size();
+	cache.handleValues(batch);
+    };
+    handler.addValueCallback(cacheCb);
+
+    /* use a real data port connection on loopback, with a client draining it */
+    boost::asio::ip::tcp::endpoint dataEndpoint(boost::asio::ip::address_v4::loopback(), 0);
+    {
+	boost::asio::ip::tcp::acceptor probe(handler, dataEndpoint);
+	dataEndpoint.port(probe.local_endpoint().port());
+    }
+    DataHandler dataHandler(handler, dataEndpoint, cache);
+    IoHandler::ValueCallback dataCb = [&] (const EmsValueBatch& batch) {
+	StageTimer t(dataStage);
+	dataHandler.handleValues(batch);
+    };
+    handler.addValueCallback(dataCb);
+
+    struct DataClient {
+	DataClient(boost::asio::io_service& ios) : socket(ios) { }
+	boost::asio::ip::tcp::socket socket;
+	char buffer[16384];
+    };
+    std::vector<std::unique_ptr<DataClient> > clients;
+    unsigned long long clientBytes = 0;
+    std::function<void (DataClient *)> startRead = [&] (DataClient *client) {
+	client->socket.async_read_some(boost::asio::buffer(client->buffer),
+		[&, client] (const boost::system::error_code& error, size_t bytes) {
+	    clientBytes += bytes;
+	    if (!error) {
+		startRead(client);
+	    }
+	});
+    };
+    for (unsigned int i = 0; i < dataClients; i++) {
+	clients.emplace_back(new DataClient(handler));
+	clients.back()->socket.connect(dataEndpoint);
+	handler.run_one();
+	startRead(clients.back().get());
+    }
+
+    IoHandler::ValueCallback mqttCb = [&] (const EmsValueBatch& batch) {
+	StageTimer t(mqttStage);
+	mqttStub(batch);
+    };
+    handler.addValueCallback(mqttCb);
+
+    IoHandler::ValueCallback dbCb = [&] (const EmsValueBatch& batch) {
+	StageTimer t(dbStage);
+	dbStub(batch);
+    };
+    handler.addValueCallback(dbCb);
+
+    /* warm up (fills the cache and the name lookup tables) */
+    handler.feed(stream.data(), stream.size(), chunkSize);
+    handler.poll();
+    values = 0;
+    feedStage = Stage("feed");
+    frameStage = Stage("frame");
+    cacheStage = Stage("cache");
+    dataStage = Stage("data");
+    mqttStage = Stage("mqtt");
+    dbStage = Stage("db");
+
+    unsigned long long startAllocations = allocationCount;
+    Clock::time_point start = Clock::now();
+    for (unsigned int i = 0; i < iterations; i++) {
+	handler.feed(stream.data(), stream.size(), chunkSize);
+	/* writes to the data port clients */
+	StageTimer t(pollStage);
+	handler.poll();
+    }
+    Clock::duration total = Clock::now() - start;
+    unsigned long long totalAllocations = allocationCount - startAllocations;
+
+    /* all stages are measured in the run above; the nested timers are
+     * separated here, their own overhead counts towards the outer stage */
+    extractStage.time = feedStage.time - frameStage.time;
+    extractStage.allocations = feedStage.allocations - frameStage.allocations;
+    decodeStage.time = frameStage.time - cacheStage.time -
+	    dataStage.time - mqttStage.time - dbStage.time;
+    decodeStage.allocations = frameStage.allocations - cacheStage.allocations -
+	    dataStage.allocations - mqttStage.allocations - dbStage.allocations;
+    dataStage.time += pollStage.time;
+    dataStage.allocations += pollStage.allocations;
+
+    size_t frames = framesPerIteration * iterations;
+    double seconds = std::chrono::duration<double>(total).count();
+
+    std::cout << "{" << std::endl;
+    std::cout << "  \"input\": \"" << (captureFile.empty() ? "synthetic" : captureFile) << "\"," << std::endl;
+    std::cout << "  \"iterations\": " << iterations << "," << std::endl;
+    std::cout << "  \"chunk_size\": " << chunkSize << "," << std::endl;
+    std::cout << "  \"frames\": " << frames << "," << std::endl;
+    std::cout << "  \"values\": " << values << "," << std::endl;
+    std::cout << "  \"data_clients\": " << dataClients << "," << std::endl;
+    std::cout << "  \"data_port_bytes\": " << clientBytes << "," << std::endl;
+    std::cout << "  \"seconds\": " << seconds << "," << std::endl;
+    std::cout << "  \"frames_per_second\": " << frames / seconds << "," << std::endl;
+    std::cout << "  \"values_per_second\": " << values / seconds << "," << std::endl;
+    std::cout << "  \"allocations_per_frame\": " << (double) totalAllocations / frames << "," << std::endl;
+    std::cout << "  \"stages\": {" << std::endl;
+    printStage(extractStage, frames, false);
+    printStage(decodeStage, frames, false);
+    printStage(cacheStage, frames, false);
+    printStage(dataStage, frames, false);
+    printStage(mqttStage, frames, false);
+    printStage(dbStage, frames, true);
+    std::cout << "  }" << std::endl;
+    std::cout << "}" << std::endl;
+
+    return 0;
+}
@@ -24,22 +24,26 @@
 #include "IoHandler.h"
 #include "Options.h"
 
-IoHandler::IoHandler(ValueCache& cache) :
+IoHandler::IoHandler(ValueCache& cache, bool capture) :
     boost::asio::io_service(),
     IncomingMessageHandler(cache),
     m_active(true),
-    m_state(Syncing),
-    m_pos(0)
+    m_frameExtractor(boost::bind(&IoHandler::handleFrame, this,
+				 boost::placeholders::_1, boost::placeholders::_2))
 {
-    /* pre-alloc buffer to avoid reallocations */
-    m_data.reserve(256);
+    const std::string& captureFile = Options::captureFile();
+    if (capture && !captureFile.empty()) {
+	m_capture.reset(new FrameCapture(captureFile));
+	if (!m_capture->isOpen()) {
+	    m_capture.reset();
+	}
+    }
 }
 
 void
 IoHandler::readComplete(const boost::system::error_code& error,
 			size_t bytesTransferred)
 {
-    size_t pos = 0;
     DebugStream& debug = Options::ioDebug();
 
     if (error) {
@@ -57,48 +61,20 @@ IoHandler::readComplete(const boost::system::error_code& error,
 	debug << std::endl;
     }
 
-    while (pos < bytesTransferred) {
-	unsigned char dataByte = m_recvBuffer[pos++];
-
-	switch (m_state) {
-	    case Syncing:
-		if (m_pos == 0 && dataByte == 0xaa) {
-		    m_pos = 1;
-		} else if (m_pos == 1 && dataByte == 0x55) {
-		    m_state = Length;
-		    m_pos = 0;
-		} else {
-		    m_pos = 0;
-		}
-		break;
-	    case Length:
-		m_state = Data;
-		m_pos = 0;
-		m_length = dataByte;
-		m_checkSum = 0;
-		break;
-	    case Data:
-		m_data.push_back(dataByte);
-		m_checkSum ^= dataByte;
-		m_pos++;
-		if (m_pos == m_length) {
-		    m_state = Checksum;
-		}
-		break;
-	    case Checksum:
-		if (m_checkSum == dataByte) {
-		    handleIncomingMessage(m_data);
-		}
-		m_data.clear();
-		m_state = Syncing;
-		m_pos = 0;
-		break;
-	}
-    }
+    m_frameExtractor.feed(m_recvBuffer, bytesTransferred);
 
     readStart();
 }
 
+void
+IoHandler::handleFrame(const uint8_t *data, size_t length)
+{
+    if (m_capture) {
+	m_capture->write(data, length);
+    }
+    handleIncomingMessage(data, length);
+}
+
 void
 IoHandler::doClose(const boost::system::error_code& error)
 {
@@ -24,14 +24,18 @@
 #include <boost/asio.hpp>
 #include <boost/bind/bind.hpp>
 #include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
 #include "EmsMessage.h"
+#include "FrameCapture.h"
+#include "FrameExtractor.h"
 #include "IncomingMessageHandler.h"
 #include "ValueCache.h"
 
 class IoHandler : public boost::asio::io_service, public IncomingMessageHandler
 {
     public:
-	IoHandler(ValueCache& cache);
+	/* capture: record the received frames into the --capture-file */
+	IoHandler(ValueCache& cache, bool capture = true);
 
 	void close() {
 	    post(boost::bind(&IoHandler::doClose, this,
@@ -41,6 +45,10 @@ class IoHandler : public boost::asio::io_service, public IncomingMessageHandler
 	bool active() {
 	    return m_active;
 	}
+	/* whether to start over after the handler stopped */
+	virtual bool shouldReconnect() const {
+	    return true;
+	}
 
     protected:
 	/* maximum amount of data to read in one operation */
@@ -56,17 +64,11 @@ class IoHandler : public boost::asio::io_service, public IncomingMessageHandler
 	unsigned char m_recvBuffer[maxReadLength];
 
     private:
-	typedef enum {
-	    Syncing,
-	    Length,
-	    Data,
-	    Checksum
-	} State;
+	void handleFrame(const uint8_t *data, size_t length);
 
-	State m_state;
-	size_t m_pos, m_length;
-	uint8_t m_checkSum;
-	std::vector<uint8_t> m_data;
+    private:
+	FrameExtractor m_frameExtractor;
+	boost::scoped_ptr<FrameCapture> m_capture;
 };
 
 #endif /* __IOHANDLER_H__ */
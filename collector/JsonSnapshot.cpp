@@ -0,0 +1,136 @@
+/*
+ * Buderus EMS data collector
+ *
+ * Copyright (C) 2011 Danny Baumann <dannybaumann@web.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <boost/bind/bind.hpp>
+#include "JsonSnapshot.h"
+
+JsonSnapshot::JsonSnapshot(boost::asio::io_service& ios, ValueCache& cache,
+			   const std::string& file) :
+    m_cache(cache),
+    m_file(file),
+    m_epoch(time(NULL)),
+    m_writeTimer(ios),
+    m_writePending(false),
+    m_writtenGeneration(0),
+    m_written(false)
+{
+    /* the cache might already contain values from its file */
+    scheduleWrite();
+}
+
+JsonSnapshot::~JsonSnapshot()
+{
+    m_writeTimer.cancel();
+}
+
+JsonSnapshot::Ptr
+JsonSnapshot::current()
+{
+    if (m_document && m_document->generation == m_cache.generation()) {
+	return m_document;
+    }
+
+    boost::shared_ptr<Document> document(new Document);
+    std::ostringstream stream;
+    std::ostringstream etag;
+
+    document->generation = m_cache.outputJson(std::vector<std::string>(), stream);
+    document->body = stream.str();
+    etag << '"' << m_epoch << '-' << document->generation << '"';
+    document->etag = etag.str();
+
+    /* documents still being sent keep the old one alive */
+    m_document = document;
+    return m_document;
+}
+
+void
+JsonSnapshot::handleValues(const EmsValueBatch& /* values */)
+{
+    scheduleWrite();
+}
+
+void
+JsonSnapshot::scheduleWrite()
+{
+    if (m_file.empty() || m_writePending) {
+	return;
+    }
+
+    m_writePending = true;
+    m_writeTimer.expires_from_now(boost::posix_time::milliseconds(WriteDelay));
+    m_writeTimer.async_wait(boost::bind(&JsonSnapshot::handleWriteTimer, this,
+					boost::asio::placeholders::error));
+}
+
+void
+JsonSnapshot::handleWriteTimer(const boost::system::error_code& error)
+{
+    if (error == boost::asio::error::operation_aborted) {
+	return;
+    }
+
+    m_writePending = false;
+    if (m_written && m_cache.generation() == m_writtenGeneration) {
+	return;
+    }
+
+    Ptr document = current();
+    if (writeFile(*document)) {
+	m_writtenGeneration = document->generation;
+	m_written = true;
+    }
+}
+
+bool
+JsonSnapshot::writeFile(const Document& document)
+{
+    /* readers must never see a partially written file */
+    std::string tempFile = m_file + ".tmp";
+
+    {
+	std::ofstream file(tempFile.c_str(), std::ios::out | std::ios::trunc);
+	file << document.body;
+	file.close();
+	if (!file) {
+	    std::cerr << "Could not write JSON snapshot " << tempFile << std::endl;
+	    std::remove(tempFile.c_str());
+	    return false;
+	}
+    }
+
+    if (std::rename(tempFile.c_str(), m_file.c_str()) != 0) {
+	/* Windows doesn't replace existing files */
+	std::remove(m_file.c_str());
+	if (std::rename(tempFile.c_str(), m_file.c_str()) != 0) {
+	    std::cerr << "Could not rename JSON snapshot to " << m_file << ": "
+		      << strerror(errno) << std::endl;
+	    std::remove(tempFile.c_str());
+	    return false;
+	}
+    }
+
+    return true;
+}
@@ -0,0 +1,79 @@
+/*
+ * Buderus EMS data collector
+ *
+ * Copyright (C) 2011 Danny Baumann <dannybaumann@web.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __JSONSNAPSHOT_H__
+#define __JSONSNAPSHOT_H__
+
+#include <boost/asio.hpp>
+#include <boost/shared_ptr.hpp>
+#include "EmsMessage.h"
+#include "Noncopyable.h"
+#include "ValueCache.h"
+
+/*
+ * JSON document of all cached values, rendered again only if the cache
+ * generation changed since the last time it was asked for. Receiving
+ * unchanged values doesn't change the generation, so the timestamps in it
+ * may lag behind. Optionally, the document is also kept in a file for
+ * being served by other web servers.
+ */
+class JsonSnapshot : private boost::noncopyable
+{
+    public:
+	struct Document {
+	    uint64_t generation;
+	    /* quoted, as sent in the ETag header */
+	    std::string etag;
+	    std::string body;
+	};
+	typedef boost::shared_ptr<const Document> Ptr;
+
+    public:
+	/* the file is not written if its name is empty */
+	JsonSnapshot(boost::asio::io_service& ios, ValueCache& cache,
+		     const std::string& file);
+	~JsonSnapshot();
+
+    public:
+	/* the document of the current generation */
+	Ptr current();
+	/* schedules writing the file, if there is one */
+	void handleValues(const EmsValueBatch& values);
+
+    private:
+	void scheduleWrite();
+	void handleWriteTimer(const boost::system::error_code& error);
+	bool writeFile(const Document& document);
+
+    private:
+	/* minimum interval (in ms) between two writes of the file */
+	static const unsigned int WriteDelay = 1000;
+
+	ValueCache& m_cache;
+	std::string m_file;
+	/* distinguishes the generations of different runs in ETags */
+	time_t m_epoch;
+	Ptr m_document;
+	boost::asio::deadline_timer m_writeTimer;
+	bool m_writePending;
+	uint64_t m_writtenGeneration;
+	bool m_written;
+};
+
+#endif /* __JSONSNAPSHOT_H__ */
@@ -21,7 +21,7 @@
 #include <boost/bind/bind.hpp>
 #include "MqttAdapter.h"
 #include "Options.h"
-#include "ValueApi.h"
+#include "ValueEnvelope.h"
 
 MqttAdapter::MqttAdapter(boost::asio::io_service& ios,
 			 EmsCommandSender *sender,
@@ -48,30 +48,30 @@ MqttAdapter::MqttAdapter(boost::asio::io_service& ios,
 }
 
 void
-MqttAdapter::handleValue(const EmsValue& value)
+MqttAdapter::handleValues(const EmsValueBatch& values)
 {
     if (!m_connected) {
 	return;
     }
 
-    std::string type = ValueApi::getTypeName(value.getType());
-    std::string subtype = ValueApi::getSubTypeName(value.getSubType());
+    DebugStream& debug = Options::ioDebug();
+    const std::string prefix = m_topicPrefix + "/";
 
-    std::string topic = m_topicPrefix + "/sensor/";
-    if (!subtype.empty()) {
-	topic += subtype + "/";
-    }
-    if (!type.empty()) {
-	topic += type + "/";
-    }
-    topic += "value";
+    std::string topic;
 
-    std::string formattedValue = ValueApi::formatValue(value);
-    DebugStream& debug = Options::ioDebug();
-    if (debug) {
-	debug << "MQTT: publishing topic '" << topic << "' with value " << formattedValue << std::endl;
+    for (size_t i = 0; i < values.size(); i++) {
+	ValueEnvelope::Ptr envelope = ValueEnvelope::get(values, i);
+	boost::string_ref suffix = envelope->topic();
+
+	topic.assign(prefix);
+	topic.append(suffix.data(), suffix.size());
+	std::string formattedValue = envelope->value().to_string();
+
+	if (debug) {
+	    debug << "MQTT: publishing topic '" << topic << "' with value " << formattedValue << std::endl;
+	}
+	m_client->publish(topic, formattedValue, mqtt::qos::at_most_once);
     }
-    m_client->publish(topic, formattedValue, mqtt::qos::at_most_once);
 }
 
 bool
@@ -40,7 +40,7 @@ class MqttAdapter : public boost::noncopyable
 		    const std::string& host, const std::string& port,
 		    const std::string& topicPrefix);
 
-	void handleValue(const EmsValue& value);
+	void handleValues(const EmsValueBatch& values);
 
     private:
 	bool onConnect(bool sessionPresent, mqtt::connect_return_code returnCode);
@@ -99,7 +99,7 @@ class MqttAdapter {
 		    const std::string& /* topicPrefix */)
 	{}
 
-	void handleValue(const EmsValue& /* value */) {}
+	void handleValues(const EmsValueBatch& /* values */) {}
 };
 
 #endif /* !HAVE_MQTT */
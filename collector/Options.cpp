@@ -18,6 +18,7 @@
  */
 
 #include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/tokenizer.hpp>
 #include <boost/program_options.hpp>
 #include "Options.h"
@@ -25,9 +26,12 @@
 namespace bpo = boost::program_options;
 
 std::string Options::m_target;
+std::string Options::m_captureFile;
+double Options::m_replaySpeed = 1;
 std::string Options::m_mqttTarget;
 std::string Options::m_mqttPrefix;
 unsigned int Options::m_rateLimit = 0;
+unsigned int Options::m_resendInterval = 60;
 DebugStream Options::m_debugStreams[DebugCount];
 std::string Options::m_pidFilePath;
 bool Options::m_daemonize = true;
@@ -36,6 +40,14 @@ std::string Options::m_dbUser;
 std::string Options::m_dbPass;
 unsigned int Options::m_commandPort = 0;
 unsigned int Options::m_dataPort = 0;
+unsigned int Options::m_httpPort = 0;
+unsigned int Options::m_dataQueueSize = 65536;
+unsigned int Options::m_dataReplaySize = 4096;
+Options::DataOverflowPolicy Options::m_dataOverflowPolicy = Options::DataDropOldest;
+unsigned int Options::m_historySize = 360;
+unsigned int Options::m_historyInterval = 10;
+std::string Options::m_cacheFile;
+std::string Options::m_jsonSnapshotFile;
 Options::RoomControllerType Options::m_rcType = Options::RCUnknown;
 
 static void
@@ -47,6 +59,7 @@ usage(std::ostream& stream, const char *programName,
     stream << "  serial:<device>     Connect to serial device <device> without sending support (e.g. Atmega8)" << std::endl;
     stream << "  tx-serial:<device>  Connect to serial device <device> with sending support (e.g. EMS Gateway)" << std::endl;
     stream << "  tcp:<host>:<port>   Connect to TCP address <host> at <port> (e.g. NetIO)" << std::endl;
+    stream << "  replay:<file>       Replay frames recorded with --capture-file from <file>" << std::endl;
     stream << options << std::endl;
 }
 
@@ -54,7 +67,7 @@ Options::ParseResult
 Options::parse(int argc, char *argv[])
 {
     std::string defaultPidFilePath;
-    std::string config, rcType;
+    std::string config, rcType, replaySpeed, dataOverflow;
 
     defaultPidFilePath = "/var/run/";
     defaultPidFilePath += argv[0];
@@ -67,9 +80,16 @@ Options::parse(int argc, char *argv[])
 	 "Type of used room controller (rc30 or rc35)")
 	("ratelimit,r", bpo::value<unsigned int>(&m_rateLimit)->default_value(60),
 	 "Rate limit (in s) for writing numeric sensor values into DB")
+	("resend-interval", bpo::value<unsigned int>(&m_resendInterval)->default_value(60),
+	 "Interval (in s) in which values are passed on even if unchanged (0 = always pass on all values)")
 	("debug,d", bpo::value<std::string>()->default_value("none"),
 	 "Comma separated list of debug flags (all, io, message, data, stats, none) "
-	 " and their files, e.g. message=/tmp/messages.txt");
+	 " and their files, e.g. message=/tmp/messages.txt")
+	("capture-file", bpo::value<std::string>(&m_captureFile)->composing(),
+	 "File to record all received frames into (for replaying them later), "
+	 "not used by replay targets")
+	("replay-speed", bpo::value<std::string>(&replaySpeed)->default_value("realtime"),
+	 "Speed for replay targets: realtime, max or an acceleration factor (e.g. 10)");
 
     bpo::options_description daemon("Daemon options");
     daemon.add_options()
@@ -98,7 +118,24 @@ Options::parse(int argc, char *argv[])
 	("command-port,C", bpo::value<unsigned int>(&m_commandPort)->composing(),
 	 "TCP port for remote command interface (0 to disable)")
 	("data-port,D", bpo::value<unsigned int>(&m_dataPort)->composing(),
-	 "TCP port for broadcasting live sensor data (0 to disable)");
+	 "TCP port for broadcasting live sensor data (0 to disable)")
+	("http-port", bpo::value<unsigned int>(&m_httpPort)->composing(),
+	 "TCP port for serving the cached values and live updates via HTTP (0 to disable)")
+	("data-queue-size", bpo::value<unsigned int>(&m_dataQueueSize)->default_value(65536),
+	 "Maximum number of bytes queued for a data port client")
+	("data-replay-size", bpo::value<unsigned int>(&m_dataReplaySize)->default_value(4096),
+	 "Number of values kept for data port clients resuming after reconnecting")
+	("data-overflow", bpo::value<std::string>(&dataOverflow)->default_value("drop-oldest"),
+	 "What to do if a data port client's queue is full: drop-oldest, "
+	 "conflate (keep only the latest value of each sensor) or disconnect")
+	("history-size", bpo::value<unsigned int>(&m_historySize)->default_value(360),
+	 "Number of samples kept per value for 'cache history' (0 to disable)")
+	("history-interval", bpo::value<unsigned int>(&m_historyInterval)->default_value(10),
+	 "Minimum interval (in s) between two history samples of a value")
+	("cache-file", bpo::value<std::string>(&m_cacheFile)->composing(),
+	 "File to keep the value cache in, for having values available after restarts")
+	("json-snapshot-file", bpo::value<std::string>(&m_jsonSnapshotFile)->composing(),
+	 "File to keep a JSON document of the cached values in, e.g. for web servers");
 
 #ifdef HAVE_MQTT
     bpo::options_description interface("Interface options");
@@ -191,6 +228,37 @@ Options::parse(int argc, char *argv[])
 	}
     }
 
+    if (replaySpeed == "realtime") {
+	m_replaySpeed = 1;
+    } else if (replaySpeed == "max") {
+	m_replaySpeed = 0;
+    } else {
+	try {
+	    m_replaySpeed = boost::lexical_cast<double>(replaySpeed);
+	} catch (boost::bad_lexical_cast& e) {
+	    m_replaySpeed = -1;
+	}
+	if (m_replaySpeed <= 0) {
+	    usage(std::cerr, argv[0], visible);
+	    return ParseFailure;
+	}
+    }
+
+    if (dataOverflow == "drop-oldest") {
+	m_dataOverflowPolicy = DataDropOldest;
+    } else if (dataOverflow == "conflate") {
+	m_dataOverflowPolicy = DataConflate;
+    } else if (dataOverflow == "disconnect") {
+	m_dataOverflowPolicy = DataDisconnect;
+    } else {
+	usage(std::cerr, argv[0], visible);
+	return ParseFailure;
+    }
+    if (m_dataQueueSize == 0) {
+	usage(std::cerr, argv[0], visible);
+	return ParseFailure;
+    }
+
     if (variables.count("foreground")) {
 	m_daemonize = false;
     }
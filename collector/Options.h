@@ -72,13 +72,29 @@ class Options
 	    RC35
 	} RoomControllerType;
 
+	/* what to do with data port clients not reading fast enough */
+	typedef enum {
+	    DataDropOldest,
+	    DataConflate,
+	    DataDisconnect
+	} DataOverflowPolicy;
+
 	static unsigned int rateLimit() {
 	    return m_rateLimit;
 	}
+	static unsigned int resendInterval() {
+	    return m_resendInterval;
+	}
 
 	static const std::string& target() {
 	    return m_target;
 	}
+	static const std::string& captureFile() {
+	    return m_captureFile;
+	}
+	static double replaySpeed() {
+	    return m_replaySpeed;
+	}
 	static const std::string& mqttTarget() {
 	    return m_mqttTarget;
 	}
@@ -106,6 +122,30 @@ class Options
 	static unsigned int dataPort() {
 	    return m_dataPort;
 	}
+	static unsigned int httpPort() {
+	    return m_httpPort;
+	}
+	static unsigned int dataQueueSize() {
+	    return m_dataQueueSize;
+	}
+	static unsigned int dataReplaySize() {
+	    return m_dataReplaySize;
+	}
+	static DataOverflowPolicy dataOverflowPolicy() {
+	    return m_dataOverflowPolicy;
+	}
+	static unsigned int historySize() {
+	    return m_historySize;
+	}
+	static unsigned int historyInterval() {
+	    return m_historyInterval;
+	}
+	static const std::string& cacheFile() {
+	    return m_cacheFile;
+	}
+	static const std::string& jsonSnapshotFile() {
+	    return m_jsonSnapshotFile;
+	}
 
 	static RoomControllerType roomControllerType() {
 	    return m_rcType;
@@ -133,9 +173,12 @@ class Options
 
     private:
 	static std::string m_target;
+	static std::string m_captureFile;
+	static double m_replaySpeed;
 	static std::string m_mqttTarget;
 	static std::string m_mqttPrefix;
 	static unsigned int m_rateLimit;
+	static unsigned int m_resendInterval;
 	static std::string m_pidFilePath;
 	static bool m_daemonize;
 	static std::string m_dbPath;
@@ -143,6 +186,14 @@ class Options
 	static std::string m_dbPass;
 	static unsigned int m_commandPort;
 	static unsigned int m_dataPort;
+	static unsigned int m_httpPort;
+	static unsigned int m_dataQueueSize;
+	static unsigned int m_dataReplaySize;
+	static DataOverflowPolicy m_dataOverflowPolicy;
+	static unsigned int m_historySize;
+	static unsigned int m_historyInterval;
+	static std::string m_cacheFile;
+	static std::string m_jsonSnapshotFile;
 	static RoomControllerType m_rcType;
 };
 
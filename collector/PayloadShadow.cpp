@@ -0,0 +1,58 @@
+/*
+ * Buderus EMS data collector
+ *
+ * Copyright (C) 2011 Danny Baumann <dannybaumann@web.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include "PayloadShadow.h"
+
+const PayloadShadow::Entry *
+PayloadShadow::lookup(size_t slot, time_t now)
+{
+    if (slot >= m_entries.size()) {
+	m_entries.resize(slot + 1);
+    }
+    if (!m_entries[slot]) {
+	m_entries[slot].reset(new Entry());
+    }
+
+    Entry *entry = m_entries[slot].get();
+    if (now - entry->m_lastFullUpdate >= (time_t) m_resendInterval) {
+	entry->m_lastFullUpdate = now;
+	return NULL;
+    }
+
+    return entry;
+}
+
+void
+PayloadShadow::update(size_t slot, size_t offset, const uint8_t *data, size_t length)
+{
+    Entry *entry = m_entries[slot].get();
+
+    if (offset >= MaxPosition) {
+	return;
+    }
+    if (offset + length > MaxPosition) {
+	length = MaxPosition - offset;
+    }
+
+    memcpy(entry->m_data + offset, data, length);
+    for (size_t pos = offset; pos < offset + length; pos++) {
+	entry->m_known[pos / 8] |= 1 << (pos % 8);
+    }
+}
@@ -0,0 +1,91 @@
+/*
+ * Buderus EMS data collector
+ *
+ * Copyright (C) 2011 Danny Baumann <dannybaumann@web.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PAYLOADSHADOW_H__
+#define __PAYLOADSHADOW_H__
+
+#include <time.h>
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "Noncopyable.h"
+
+/*
+ * Keeps the last payload received for each message (indexed by the
+ * message's decoder binding), so that the decoder can skip fields whose
+ * bytes didn't change since the previous broadcast. Every resendInterval
+ * seconds, a message is decoded completely again to keep sinks fresh.
+ */
+class PayloadShadow : private boost::noncopyable
+{
+    public:
+	/* payload bytes beyond this position are always considered changed */
+	static const size_t MaxPosition = 256;
+
+	class Entry {
+	    public:
+		Entry() :
+		    m_lastFullUpdate(0)
+		{
+		    memset(m_known, 0, sizeof(m_known));
+		}
+
+		bool hasChanged(size_t offset, const uint8_t *data,
+				size_t size, uint8_t mask) const {
+		    if (offset + size > MaxPosition) {
+			return true;
+		    }
+		    for (size_t i = 0; i < size; i++) {
+			size_t pos = offset + i;
+			if (!isKnown(pos) || ((m_data[pos] ^ data[i]) & mask)) {
+			    return true;
+			}
+		    }
+		    return false;
+		}
+
+	    private:
+		friend class PayloadShadow;
+
+		bool isKnown(size_t pos) const {
+		    return m_known[pos / 8] & (1 << (pos % 8));
+		}
+
+		uint8_t m_data[MaxPosition];
+		uint8_t m_known[MaxPosition / 8];
+		time_t m_lastFullUpdate;
+	};
+
+    public:
+	PayloadShadow(unsigned int resendInterval) :
+	    m_resendInterval(resendInterval)
+	{ }
+
+	/* returns NULL if the message needs to be decoded completely */
+	const Entry * lookup(size_t slot, time_t now);
+	void update(size_t slot, size_t offset, const uint8_t *data, size_t length);
+
+    private:
+	unsigned int m_resendInterval;
+	std::vector<boost::shared_ptr<Entry> > m_entries;
+};
+
+#endif /* __PAYLOADSHADOW_H__ */
@@ -0,0 +1,171 @@
+/*
+ * Buderus EMS data collector
+ *
+ * Copyright (C) 2011 Danny Baumann <dannybaumann@web.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <iostream>
+#include "ByteOrder.h"
+#include "Options.h"
+#include "ReplayHandler.h"
+
+ReplayHandler::ReplayHandler(const std::string& file, ValueCache& cache) :
+    /* recording the replayed frames again is pointless, and would even
+     * truncate the file being replayed if it's the capture file */
+    IoHandler(cache, false),
+    m_data(NULL),
+    m_size(0),
+    m_pos(0),
+    m_speed(Options::replaySpeed()),
+    m_timer(*this)
+{
+    try {
+	boost::interprocess::file_mapping mapping(file.c_str(), boost::interprocess::read_only);
+	boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+	m_file.swap(mapping);
+	m_region.swap(region);
+    } catch (boost::interprocess::interprocess_exception& e) {
+	std::cerr << "Failed to open replay file " << file << ": " << e.what() << std::endl;
+	close();
+	return;
+    }
+
+    m_data = (const uint8_t *) m_region.get_address();
+    m_size = m_region.get_size();
+
+    const FrameCapture::FileHeader *header = (const FrameCapture::FileHeader *) m_data;
+    if (m_size < sizeof(*header) ||
+	    memcmp(header->magic, FrameCapture::Magic, sizeof(header->magic)) != 0 ||
+	    LE32_TO_CPU(header->version) != FrameCapture::Version) {
+	std::cerr << "Replay file " << file << " is not a valid capture file." << std::endl;
+	close();
+	return;
+    }
+    m_pos = sizeof(*header);
+
+    const FrameCapture::RecordHeader *first = currentRecord();
+    if (first) {
+	m_firstRecordTime = recordTime(first);
+    }
+    m_startTime = boost::posix_time::microsec_clock::universal_time();
+
+    readStart();
+}
+
+const FrameCapture::RecordHeader *
+ReplayHandler::currentRecord() const
+{
+    const FrameCapture::RecordHeader *record = (const FrameCapture::RecordHeader *) (m_data + m_pos);
+
+    if (m_pos + sizeof(*record) > m_size || m_pos + sizeof(*record) + record->length > m_size) {
+	/* end of file or truncated record */
+	return NULL;
+    }
+
+    return record;
+}
+
+boost::posix_time::time_duration
+ReplayHandler::recordTime(const FrameCapture::RecordHeader *record) const
+{
+    return boost::posix_time::seconds(LE32_TO_CPU(record->seconds)) +
+	    boost::posix_time::microseconds(LE32_TO_CPU(record->microseconds));
+}
+
+boost::posix_time::ptime
+ReplayHandler::dueTime(const FrameCapture::RecordHeader *record) const
+{
+    boost::posix_time::time_duration offset = recordTime(record) - m_firstRecordTime;
+    int64_t scaled = (int64_t) (offset.total_microseconds() / m_speed);
+
+    return m_startTime + boost::posix_time::microseconds(scaled);
+}
+
+void
+ReplayHandler::readStart()
+{
+    const FrameCapture::RecordHeader *record = currentRecord();
+
+    if (!record) {
+	DebugStream& debug = Options::ioDebug();
+	if (debug) {
+	    debug << "IO: Replay finished" << std::endl;
+	}
+	close();
+	return;
+    }
+
+    if (m_speed <= 0) {
+	/* don't call into readComplete() directly to give other handlers
+	 * (e.g. the command port) a chance to run in between */
+	post(boost::bind(&ReplayHandler::replayNext, this, boost::system::error_code()));
+    } else {
+	m_timer.expires_at(dueTime(record));
+	m_timer.async_wait(boost::bind(&ReplayHandler::replayNext, this,
+				       boost::asio::placeholders::error));
+    }
+}
+
+void
+ReplayHandler::replayNext(const boost::system::error_code& error)
+{
+    if (error || !m_active) {
+	return;
+    }
+
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    size_t filled = 0;
+
+    /* re-frame as many records as fit into the receive buffer, but
+     * only the ones which are already due when pacing */
+    while (const FrameCapture::RecordHeader *record = currentRecord()) {
+	size_t frameLength = 3 + record->length + 1;
+
+	if (filled + frameLength > maxReadLength) {
+	    break;
+	}
+	if (m_speed > 0 && filled > 0) {
+	    if (dueTime(record) > now) {
+		break;
+	    }
+	}
+
+	const uint8_t *payload = (const uint8_t *) (record + 1);
+	uint8_t *frame = m_recvBuffer + filled;
+	uint8_t checksum = 0;
+
+	frame[0] = 0xaa;
+	frame[1] = 0x55;
+	frame[2] = record->length;
+	memcpy(frame + 3, payload, record->length);
+	for (size_t i = 0; i < record->length; i++) {
+	    checksum ^= payload[i];
+	}
+	frame[3 + record->length] = checksum;
+
+	filled += frameLength;
+	m_pos += sizeof(*record) + record->length;
+    }
+
+    readComplete(boost::system::error_code(), filled);
+}
+
+void
+ReplayHandler::doCloseImpl()
+{
+    m_timer.cancel();
+}
@@ -0,0 +1,65 @@
+/*
+ * Buderus EMS data collector
+ *
+ * Copyright (C) 2011 Danny Baumann <dannybaumann@web.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __REPLAYHANDLER_H__
+#define __REPLAYHANDLER_H__
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "IoHandler.h"
+
+/*
+ * Feeds the frames of a capture file (see FrameCapture) through the
+ * regular receive path, either paced like they were recorded (optionally
+ * accelerated) or as fast as possible.
+ */
+class ReplayHandler : public IoHandler
+{
+    public:
+	ReplayHandler(const std::string& file, ValueCache& cache);
+
+	/* a replay doesn't need to be retried once it's finished */
+	virtual bool shouldReconnect() const {
+	    return false;
+	}
+
+    protected:
+	virtual void readStart();
+	virtual void doCloseImpl();
+
+    private:
+	void replayNext(const boost::system::error_code& error);
+	boost::posix_time::time_duration recordTime(const FrameCapture::RecordHeader *header) const;
+	boost::posix_time::ptime dueTime(const FrameCapture::RecordHeader *header) const;
+	const FrameCapture::RecordHeader * currentRecord() const;
+
+    private:
+	boost::interprocess::file_mapping m_file;
+	boost::interprocess::mapped_region m_region;
+	const uint8_t *m_data;
+	size_t m_size;
+	size_t m_pos;
+	/* 0 = as fast as possible */
+	double m_speed;
+	boost::asio::deadline_timer m_timer;
+	boost::posix_time::ptime m_startTime;
+	boost::posix_time::time_duration m_firstRecordTime;
+};
+
+#endif /* __REPLAYHANDLER_H__ */
@@ -0,0 +1,73 @@
+/*
+ * Buderus EMS data collector
+ *
+ * Copyright (C) 2011 Danny Baumann <dannybaumann@web.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SEQLOCK_H__
+#define __SEQLOCK_H__
+
+#include <atomic>
+#include <thread>
+#include <stdint.h>
+
+/*
+ * Sequence lock for data with a single writer: readers never block the
+ * writer, but copy the data and retry if it was modified meanwhile.
+ *
+ * Writer:  lock.writeBegin(); <modify>; lock.writeEnd();
+ * Readers: do { seq = lock.readBegin(); <copy>; } while (lock.readRetry(seq));
+ */
+class SeqLock
+{
+    public:
+	SeqLock() :
+	    m_sequence(0)
+	{ }
+
+	/* only valid while there are neither readers nor a writer */
+	void reset() {
+	    m_sequence.store(0, std::memory_order_relaxed);
+	}
+
+	void writeBegin() {
+	    m_sequence.store(m_sequence.load(std::memory_order_relaxed) + 1,
+			     std::memory_order_relaxed);
+	    std::atomic_thread_fence(std::memory_order_release);
+	}
+	void writeEnd() {
+	    m_sequence.store(m_sequence.load(std::memory_order_relaxed) + 1,
+			     std::memory_order_release);
+	}
+
+	uint32_t readBegin() const {
+	    uint32_t sequence;
+	    /* odd while a write is in progress */
+	    while ((sequence = m_sequence.load(std::memory_order_acquire)) & 1) {
+		std::this_thread::yield();
+	    }
+	    return sequence;
+	}
+	bool readRetry(uint32_t sequence) const {
+	    std::atomic_thread_fence(std::memory_order_acquire);
+	    return m_sequence.load(std::memory_order_relaxed) != sequence;
+	}
+
+    private:
+	std::atomic<uint32_t> m_sequence;
+};
+
+#endif /* __SEQLOCK_H__ */
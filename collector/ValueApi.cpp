@@ -17,317 +17,254 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <map>
-#include <sstream>
-#include <boost/format.hpp>
-#include "ApiCommandParser.h"
+#include <cstdio>
+#include <cstdlib>
+#include "ByteOrder.h"
 #include "ValueApi.h"
+#include "ValueMetadata.h"
 
-std::string
-ValueApi::getTypeName(EmsValue::Type type)
-{
-    static const std::map<EmsValue::Type, const char *> TYPEMAPPING = {
-	{ EmsValue::SollTemp, "targettemperature" },
-	{ EmsValue::IstTemp, "currenttemperature" },
-	{ EmsValue::SetTemp, "settemperature" },
-	{ EmsValue::MinTemp, "mintemperature" },
-	{ EmsValue::MaxTemp, "maxtemperature" },
-	{ EmsValue::TagTemp, "daytemperature" },
-	{ EmsValue::NachtTemp, "nighttemperature" },
-	{ EmsValue::UrlaubTemp, "vacationtemperature" },
-	{ EmsValue::RaumSollTemp, "roomtargettemperature" },
-	{ EmsValue::RaumIstTemp, "roomcurrenttemperature" },
-	{ EmsValue::RaumEinfluss, "maxroomeffect" },
-	{ EmsValue::RaumOffset, "roomtemperatureoffset" },
-	{ EmsValue::SchwelleSommerWinter, "summerwinterthreshold" },
-	{ EmsValue::FrostSchutzTemp, "frostprotecttemperature" },
-	{ EmsValue::AuslegungsTemp, "designtemperature" },
-	{ EmsValue::RaumUebersteuerTemp, "temperatureoverride" },
-	{ EmsValue::AbsenkungsSchwellenTemp, "reducedmodethreshold" },
-	{ EmsValue::UrlaubAbsenkungsSchwellenTemp, "vacationreducedmodethreshold" },
-	{ EmsValue::AbsenkungsAbbruchTemp, "cancelreducedmodethreshold" },
-	{ EmsValue::GedaempfteTemp, "dampedtemperature" },
-	{ EmsValue::DesinfektionsTemp, "desinfectiontemperature" },
-	{ EmsValue::RaumTemperaturAenderung, "roomtemperaturechange" },
-	{ EmsValue::Mischersteuerung, "mixercontrol" },
-	{ EmsValue::Flammenstrom, "flamecurrent" },
-	{ EmsValue::Systemdruck, "pressure" },
-	{ EmsValue::BetriebsZeit, "operatingminutes" },
-	{ EmsValue::BetriebsZeit2, "operatingminutes2" },
-	{ EmsValue::MinModulation, "minmodulation" },
-	{ EmsValue::MaxModulation, "maxmodulation" },
-	{ EmsValue::SollModulation, "targetmodulation" },
-	{ EmsValue::IstModulation, "currentmodulation" },
-	{ EmsValue::SollLeistung, "requestedpower" },
-	{ EmsValue::EinschaltHysterese, "onhysteresis" },
-	{ EmsValue::AusschaltHysterese, "offhysteresis" },
-	{ EmsValue::DurchflussMenge, "flowrate" },
-
-	{ EmsValue::HeizZeit, "heatingminutes" },
-	{ EmsValue::WarmwasserbereitungsZeit, "warmwaterminutes" },
-	{ EmsValue::Brennerstarts, "heaterstarts" },
-	{ EmsValue::WarmwasserBereitungen, "warmwaterpreparations" },
-	{ EmsValue::EinschaltoptimierungsZeit, "onoptimizationminutes" },
-	{ EmsValue::AusschaltoptimierungsZeit, "offoptimizationminutes" },
-	{ EmsValue::AntipendelZeit, "antipendelminutes" },
-	{ EmsValue::NachlaufZeit, "followupminutes" },
-	{ EmsValue::DesinfektionStunde, "desinfectionhour" },
-	{ EmsValue::HektoStundenVorWartung, "maintenanceintervalin100hours" },
-	{ EmsValue::PausenZeit, "pausehours" },
-	{ EmsValue::PartyZeit, "partyhours" },
-
-	{ EmsValue::FlammeAktiv, "flameactive" },
-	{ EmsValue::BrennerAktiv, "heateractive" },
-	{ EmsValue::ZuendungAktiv, "ignitionactive" },
-	{ EmsValue::PumpeAktiv, "pumpactive" },
-	{ EmsValue::ZirkulationAktiv, "zirkpumpactive" },
-	{ EmsValue::DreiWegeVentilAufWW, "3wayonww" },
-	{ EmsValue::EinmalLadungAktiv, "onetimeload" },
-	{ EmsValue::DesinfektionAktiv, "desinfectionactive" },
-	{ EmsValue::Desinfektion, "desinfection" },
-	{ EmsValue::NachladungAktiv, "boostcharge" },
-	{ EmsValue::WarmwasserBereitung, "warmwaterpreparationactive" },
-	{ EmsValue::WarmwasserTempOK, "warmwatertempok" },
-	{ EmsValue::Tagbetrieb, "daymode" },
-	{ EmsValue::Sommerbetrieb, "summermode" },
-	{ EmsValue::Ausschaltoptimierung, "offoptimization" },
-	{ EmsValue::Einschaltoptimierung, "onoptimization" },
-	{ EmsValue::Estrichtrocknung, "floordrying" },
-	{ EmsValue::WWVorrang, "wwoverride" },
-	{ EmsValue::Urlaub, "vacationmode" },
-	{ EmsValue::Ferien, "holidaymode" },
-	{ EmsValue::Party, "partymode" },
-	{ EmsValue::Pause, "pausemode" },
-	{ EmsValue::Frostschutzbetrieb, "frostprotectmodeactive" },
-	{ EmsValue::SchaltuhrEin, "switchpointactive" },
-	{ EmsValue::KesselSchalter, "masterswitch" },
-	{ EmsValue::EigenesProgrammAktiv, "customschedule" },
-	{ EmsValue::EinmalLadungsLED, "onetimeloadindicator" },
-	{ EmsValue::ATDaempfung, "outdoortempdamping" },
-	{ EmsValue::SchaltzeitOptimierung, "scheduleoptimizer" },
-	{ EmsValue::Fuehler1Defekt, "sensor1failure" },
-	{ EmsValue::Fuehler2Defekt, "sensor2failure" },
-	{ EmsValue::Stoerung, "failure" },
-	{ EmsValue::StoerungDesinfektion, "desinfectionfailure" },
-	{ EmsValue::Ladevorgang, "loading" },
-	{ EmsValue::WWSystemType, "warmwatersystemtype" },
-	{ EmsValue::Schaltpunkte, "switchpoints" },
-	{ EmsValue::Wartungsmeldungen, "maintenancereminder" },
-	{ EmsValue::WartungFaellig, "maintenancedue" },
-	{ EmsValue::Betriebsart, "opmode" },
-	{ EmsValue::DesinfektionTag, "desinfectionday" },
-	{ EmsValue::GebaeudeArt, "buildingtype" },
-	{ EmsValue::AbsenkModus, "reductionmode" },
-	{ EmsValue::HeizSystem, "heatingsystem" },
-	{ EmsValue::FuehrungsGroesse, "relevantparameter" },
-	{ EmsValue::Frostschutz, "frostprotectmode" },
-	{ EmsValue::UrlaubAbsenkungsArt, "vacationreductionmode" },
-	{ EmsValue::FBTyp, "remotecontroltype" },
-
-	{ EmsValue::HKKennlinie, "characteristic" },
-	{ EmsValue::Fehler, "error" },
-	{ EmsValue::SystemZeit, "systemtime" },
-	{ EmsValue::Wartungstermin, "maintenancedate" },
-
-	{ EmsValue::ServiceCode, "servicecode" },
-	{ EmsValue::FehlerCode, "errorcode" }
-    };
+/*
+ * The helpers below append to the buffer and return the new end position.
+ * Their output matches what std::ostream and boost::format produced before.
+ */
 
-    auto iter = TYPEMAPPING.find(type);
-    if (iter == TYPEMAPPING.end()) {
-	return "";
+static char *
+appendString(char *pos, const char *string)
+{
+    while (*string) {
+	*pos++ = *string++;
     }
-
-    return iter->second;
+    return pos;
 }
 
-std::string
-ValueApi::getSubTypeName(EmsValue::SubType subtype)
+/* like %0<width>d */
+static char *
+appendNumber(char *pos, unsigned int value, unsigned int width = 1)
 {
-    static const std::map<EmsValue::SubType, const char *> SUBTYPEMAPPING = {
-	{ EmsValue::HK1, "hk1" },
-	{ EmsValue::HK2, "hk2" },
-	{ EmsValue::HK3, "hk3" },
-	{ EmsValue::HK4, "hk4" },
-	{ EmsValue::RC, "rc" },
-	{ EmsValue::Kessel, "heater" },
-	{ EmsValue::KesselPumpe, "heaterpump" },
-	{ EmsValue::Brenner, "burner" },
-	{ EmsValue::Ruecklauf, "returnflow" },
-	{ EmsValue::Waermetauscher, "heatexchanger" },
-	{ EmsValue::WW, "ww" },
-	{ EmsValue::Zirkulation, "zirkpump" },
-	{ EmsValue::Aussen, "outdoor" },
-	{ EmsValue::Abgas, "exhaust" },
-	{ EmsValue::Ansaugluft, "intake" },
-	{ EmsValue::Solar, "solar" },
-	{ EmsValue::SolarPumpe, "solarpump" },
-	{ EmsValue::SolarSpeicher, "solartank" },
-	{ EmsValue::SolarKollektor, "solarcollector" }
-    };
+    char digits[10];
+    unsigned int count = 0;
 
-    auto iter = SUBTYPEMAPPING.find(subtype);
-    if (iter == SUBTYPEMAPPING.end()) {
-	return "";
+    do {
+	digits[count++] = '0' + value % 10;
+	value /= 10;
+    } while (value);
+    for (; count < width; width--) {
+	*pos++ = '0';
     }
-
-    return iter->second;
+    while (count) {
+	*pos++ = digits[--count];
+    }
+    return pos;
 }
 
-std::string
-ValueApi::formatValue(const EmsValue& value)
+static char *
+appendHexByte(char *pos, uint8_t value)
 {
-    static const std::map<uint8_t, const char *> WWSYSTEMMAPPING = {
-	{ EmsProto::WWSystemNone, "none" },
-	{ EmsProto::WWSystemDurchlauf, "tankless" },
-	{ EmsProto::WWSystemKlein, "small" },
-	{ EmsProto::WWSystemGross, "large" },
-	{ EmsProto::WWSystemSpeicherlade, "speicherladesystem" }
-    };
-
-    static const std::map<uint8_t, const char *> ZIRKSPMAPPING = {
-	{ 0, "off" }, { 1, "1x" }, { 2, "2x" }, { 3, "3x" },
-	{ 4, "4x" }, { 5, "5x" }, { 6, "6x" }, { 7, "alwayson" }
-    };
-
-    static const std::map<uint8_t, const char *> MAINTENANCEMESSAGESMAPPING = {
-	{ 0, "off" }, { 1, "byhours" }, { 2, "bydate" }
-    };
-
-    static const std::map<uint8_t, const char *> MAINTENANCENEEDEDMAPPING = {
-	{ 0, "no" }, { 3, "byhours" }, { 8, "bydate" }
-    };
-
-    static const std::map<uint8_t, const char *> ERRORTYPEMAPPING = {
-	{ 0x10, "L" }, { 0x11, "B" }, { 0x12, "S" }, { 0x13, "D" }
-    };
-
-    static const std::map<uint8_t, const char *> OPMODEMAPPING = {
-	{ 0, "off" }, { 1, "on" }, { 2, "auto" }
-    };
+    static const char hex[] = "0123456789abcdef";
+    *pos++ = hex[value >> 4];
+    *pos++ = hex[value & 0xf];
+    return pos;
+}
 
-    static const std::map<uint8_t, const char *> HKOPMODEMAPPING = {
-	{ 0, "night" }, { 1, "day" }, { 2, "auto" }
-    };
+/* like std::ostream << float, i.e. %g with 6 significant digits */
+static char *
+appendNumeric(char *pos, const EmsValue& value)
+{
+    int raw = value.getRawValue();
+    unsigned int divider = value.getDivider() ? value.getDivider() : 1;
+    unsigned int scale = 1, decimals = 0;
 
-    static const std::map<uint8_t, const char *> DAYMAPPING = {
-	{ 0, "monday" }, { 1, "tuesday" }, { 2, "wednesday"}, { 3, "thursday" },
-	{ 4, "friday" }, { 5, "saturday" }, { 6, "sunday" }, { 7, "everyday" }
-    };
+    /* smallest power of 10 the divider divides */
+    while (scale % divider != 0 && decimals < 3) {
+	scale *= 10;
+	decimals++;
+    }
 
-    static const std::map<uint8_t, const char *> BUILDINGTYPEMAPPING = {
-	{ 0, "light" }, { 1, "medium" }, { 2, "heavy" }
-    };
+    /*
+     * Values with at most 6 significant digits survive the conversion to
+     * float unchanged, so they can be printed from the raw value. Others
+     * need exponents or rounding and are left to printf.
+     */
+    if (scale % divider == 0 && std::abs(raw) < (1 << 24)) {
+	uint64_t digits = (uint64_t) std::abs(raw) * (scale / divider);
+	while (decimals > 0 && digits % 10 == 0) {
+	    digits /= 10;
+	    decimals--;
+	    scale /= 10;
+	}
+	if (digits < 1000000) {
+	    if (raw < 0) {
+		*pos++ = '-';
+	    }
+	    pos = appendNumber(pos, digits / scale);
+	    if (decimals > 0) {
+		*pos++ = '.';
+		pos = appendNumber(pos, digits % scale, decimals);
+	    }
+	    return pos;
+	}
+    }
 
-    static const std::map<uint8_t, const char *> HEATINGTYPEMAPPING = {
-	{ 0, "none" }, { 1, "heater" }, { 2, "convection" }, { 3, "floorheater" },
-    };
+    return pos + snprintf(pos, 16, "%g", value.getValue<float>());
+}
 
-    static const std::map<uint8_t, const char *> REDUCTIONMODEMAPPING = {
-	{ 0, "offmode" }, { 1, "reduced" }, { 2, "raumhalt" }, { 3, "aussenhalt" }
-    };
+/* like the date part of ApiCommandParser::buildRecordResponse() */
+static char *
+appendDateTime(char *pos, const EmsProto::DateTimeRecord& record)
+{
+    pos = appendNumber(pos, 2000 + record.year, 4);
+    *pos++ = '-';
+    pos = appendNumber(pos, record.month, 2);
+    *pos++ = '-';
+    pos = appendNumber(pos, record.day, 2);
+    *pos++ = ' ';
+    pos = appendNumber(pos, record.hour, 2);
+    *pos++ = ':';
+    pos = appendNumber(pos, record.minute, 2);
+    return pos;
+}
 
-    static const std::map<uint8_t, const char *> FROSTPROTECTMAPPING = {
-	{ 0, "off" }, { 1, "byoutdoortemp" }, { 2, "byindoortemp" }
-    };
+static char *
+appendError(char *pos, const EmsValue& value)
+{
+    EmsValue::ErrorEntry entry = value.getValue<EmsValue::ErrorEntry>();
+    const EmsProto::ErrorRecord& record = entry.record;
+    const ValueMetadata::EnumLabel *label =
+	    ValueMetadata::findLabel(ValueMetadata::labels(value), entry.type);
 
-    static const std::map<uint8_t, const char *> RELEVANTVALUEMAPPING = {
-	{ 0, "outdoor" }, { 1, "indoor" }
-    };
+    pos = appendString(pos, label ? label->name : "?");
+    pos = appendNumber(pos, entry.index, 2);
+    *pos++ = ' ';
 
-    static const std::map<uint8_t, const char *> VACATIONREDUCTIONMAPPING = {
-	{ 3, "outdoor" }, { 2, "indoor" }
-    };
+    if (record.errorAscii[0] == 0) {
+	return appendString(pos, "empty");
+    }
 
-    static const std::map<uint8_t, const char *> REMOTETYPEMAPPING = {
-	{ 0, "none" }, { 1, "rc20" }, { 2, "rc3x" }
-    };
+    if (record.time.valid) {
+	pos = appendDateTime(pos, record.time);
+    } else {
+	pos = appendString(pos, "xxxx-xx-xx xx:xx");
+    }
+    *pos++ = ' ';
+    pos = appendHexByte(pos, record.source);
+    *pos++ = ' ';
+    *pos++ = record.errorAscii[0];
+    *pos++ = record.errorAscii[1];
+    *pos++ = ' ';
+    pos = appendNumber(pos, BE16_TO_CPU(record.code_be16));
+    *pos++ = ' ';
+    pos = appendNumber(pos, BE16_TO_CPU(record.durationMinutes_be16));
+    return pos;
+}
 
-    std::ostringstream stream;
+size_t
+ValueApi::formatValue(const EmsValue& value, char *buffer)
+{
+    char *pos = buffer;
 
     switch (value.getReadingType()) {
 	case EmsValue::Numeric:
 	    if (!value.isValid()) {
-		stream << "unavailable";
+		pos = appendString(pos, "unavailable");
 	    } else {
-		stream << value.getValue<float>();
+		pos = appendNumeric(pos, value);
 	    }
 	    break;
 	case EmsValue::Integer:
 	    if (!value.isValid()) {
-		stream << "unavailable";
+		pos = appendString(pos, "unavailable");
 	    } else {
-		stream << value.getValue<unsigned int>();
+		pos = appendNumber(pos, value.getValue<unsigned int>());
 	    }
 	    break;
 	case EmsValue::Boolean:
-	    stream << (value.getValue<bool>() ? "on" : "off");
+	    pos = appendString(pos, value.getValue<bool>() ? "on" : "off");
 	    break;
 	case EmsValue::Enumeration: {
-	    const std::map<uint8_t, const char *> *map = NULL;
 	    uint8_t enumValue = value.getValue<uint8_t>();
-	    switch (value.getType()) {
-		case EmsValue::WWSystemType: map = &WWSYSTEMMAPPING; break;
-		case EmsValue::Schaltpunkte: map = &ZIRKSPMAPPING; break;
-		case EmsValue::Wartungsmeldungen: map = &MAINTENANCEMESSAGESMAPPING; break;
-		case EmsValue::WartungFaellig: map = &MAINTENANCENEEDEDMAPPING; break;
-		case EmsValue::Betriebsart:
-		    map = value.isForHK() ? &HKOPMODEMAPPING : &OPMODEMAPPING;
-		    break;
-		case EmsValue::DesinfektionTag: map = &DAYMAPPING; break;
-		case EmsValue::GebaeudeArt: map = &BUILDINGTYPEMAPPING; break;
-		case EmsValue::HeizSystem: map = &HEATINGTYPEMAPPING; break;
-		case EmsValue::AbsenkModus: map = &REDUCTIONMODEMAPPING; break;
-		case EmsValue::Frostschutz: map = &FROSTPROTECTMAPPING; break;
-		case EmsValue::FuehrungsGroesse: map = &RELEVANTVALUEMAPPING; break;
-		case EmsValue::FBTyp: map = &REMOTETYPEMAPPING; break;
-		case EmsValue::UrlaubAbsenkungsArt: map = &VACATIONREDUCTIONMAPPING; break;
-		default: break;
-	    }
-	    if (map && map->find(enumValue) != map->end()) {
-		stream << map->at(enumValue);
+	    const ValueMetadata::EnumLabel *label =
+		    ValueMetadata::findLabel(ValueMetadata::labels(value), enumValue);
+	    if (label && label->name) {
+		pos = appendString(pos, label->name);
 	    } else {
-		stream << (unsigned int) enumValue;
+		pos = appendNumber(pos, enumValue);
 	    }
 	    break;
 	}
 	case EmsValue::Kennlinie: {
-	    std::vector<uint8_t> kennlinie = value.getValue<std::vector<uint8_t> >();
-	    stream << boost::format("%d/%d/%d")
-		    % (unsigned int) kennlinie[0] % (unsigned int) kennlinie[1]
-		    % (unsigned int) kennlinie[2];
+	    EmsValue::KennlinieRecord kennlinie = value.getValue<EmsValue::KennlinieRecord>();
+	    pos = appendNumber(pos, kennlinie[0]);
+	    *pos++ = '/';
+	    pos = appendNumber(pos, kennlinie[1]);
+	    *pos++ = '/';
+	    pos = appendNumber(pos, kennlinie[2]);
 	    break;
 	}
-	case EmsValue::Error: {
-	    EmsValue::ErrorEntry entry = value.getValue<EmsValue::ErrorEntry>();
-	    std::string formatted = ApiCommandParser::buildRecordResponse(&entry.record);
-	    if (formatted.empty()) {
-		formatted = "empty";
-	    }
-
-	    stream << boost::format("%s%02d %s")
-		    % ERRORTYPEMAPPING.at(entry.type) % entry.index % formatted;
+	case EmsValue::Error:
+	    pos = appendError(pos, value);
 	    break;
-	}
 	case EmsValue::Date: {
 	    EmsProto::DateRecord record = value.getValue<EmsProto::DateRecord>();
-	    stream << boost::format("%04d-%02d-%02d")
-		    % (2000 + record.year) % (unsigned int) record.month
-		    % (unsigned int) record.day;
+	    pos = appendNumber(pos, 2000 + record.year, 4);
+	    *pos++ = '-';
+	    pos = appendNumber(pos, record.month, 2);
+	    *pos++ = '-';
+	    pos = appendNumber(pos, record.day, 2);
 	    break;
 	}
 	case EmsValue::SystemTime: {
 	    EmsProto::SystemTimeRecord record = value.getValue<EmsProto::SystemTimeRecord>();
-	    stream << boost::format("%04d-%02d-%02d %02d:%02d:%02d")
-		    % (2000 + record.common.year) % (unsigned int) record.common.month
-		    % (unsigned int) record.common.day % (unsigned int) record.common.hour
-		    % (unsigned int)  record.common.minute % (unsigned int) record.second;
+	    pos = appendDateTime(pos, record.common);
+	    *pos++ = ':';
+	    pos = appendNumber(pos, record.second, 2);
 	    break;
 	}
 	case EmsValue::Formatted:
-	    stream << value.getValue<std::string>();
+	    pos = appendString(pos, value.getText());
 	    break;
     }
 
-    return stream.str();
+    return pos - buffer;
+}
+
+std::string
+ValueApi::formatValue(const EmsValue& value)
+{
+    char buffer[MaxFormattedLength];
+    return std::string(buffer, formatValue(value, buffer));
+}
+
+static void
+appendJsonString(std::string& out, boost::string_ref text)
+{
+    out += '"';
+    for (char c : text) {
+	if (c == '"' || c == '\\') {
+	    out += '\\';
+	    out += c;
+	} else if ((unsigned char) c < 0x20 || (unsigned char) c >= 0x80) {
+	    /* non-ASCII characters are taken as latin1 */
+	    char escape[7] = "\\u00";
+	    appendHexByte(escape + 4, c);
+	    out.append(escape, 6);
+	} else {
+	    out += c;
+	}
+    }
+    out += '"';
+}
+
+void
+ValueApi::appendJsonFields(std::string& out, const char *subtype, const char *type,
+			   boost::string_ref value)
+{
+    if (*subtype) {
+	out += "\"subtype\":";
+	appendJsonString(out, subtype);
+	out += ',';
+    }
+    out += "\"type\":";
+    appendJsonString(out, type);
+    out += ",\"value\":";
+    appendJsonString(out, value);
 }
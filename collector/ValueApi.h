@@ -20,12 +20,21 @@
 #ifndef __VALUEAPI_H__
 #define __VALUEAPI_H__
 
+#include <boost/utility/string_ref.hpp>
 #include "EmsMessage.h"
 
 namespace ValueApi {
-    std::string getTypeName(EmsValue::Type type);
-    std::string getSubTypeName(EmsValue::SubType subtype);
+    /* size of the buffer formatValue() needs */
+    static const size_t MaxFormattedLength = 64;
+
+    /* writes the value into buffer without terminating it, returns the length */
+    size_t formatValue(const EmsValue& value, char *buffer);
     std::string formatValue(const EmsValue& value);
+
+    /* appends '"subtype":"<subtype>","type":"<type>","value":"<value>"' for
+     * JSON objects, without the subtype if it's empty */
+    void appendJsonFields(std::string& out, const char *subtype, const char *type,
+			  boost::string_ref value);
 }
 
-#endif /* __DATAHANDLER_H__ */
+#endif /* __VALUEAPI_H__ */
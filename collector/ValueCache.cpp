@@ -17,69 +17,445 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
 #include "ValueApi.h"
+#include "ValueMetadata.h"
 #include "ValueCache.h"
+#include "ValueEnvelope.h"
 
-ValueCache::ValueCache()
+const char ValueCache::SnapshotMagic[4] = { 'E', 'M', 'S', 'V' };
+
+ValueCache::ValueCache(size_t historySize, unsigned int historyInterval) :
+    m_localSnapshot(new Snapshot),
+    m_history(EntryCount),
+    m_historySize(historySize),
+    m_historyInterval(historyInterval),
+    m_lines(EntryCount),
+    m_changeLog(EntryCount),
+    m_changeLogStart(0)
 {
+    m_snapshot = m_localSnapshot.get();
+    initSnapshot(m_snapshot);
+    m_changeLogStart = m_snapshot->generation.load();
+    buildIndex();
 }
 
 ValueCache::~ValueCache()
 {
+    for (auto& history : m_history) {
+	delete history.load();
+    }
+    if (m_snapshotRegion.get_address()) {
+	m_snapshotRegion.flush();
+    }
 }
 
 void
-ValueCache::handleValue(const EmsValue& value)
+ValueCache::initSnapshot(Snapshot *snapshot)
 {
-    CacheKey key(value.getType(), value.getSubType());
-    m_cache.erase(key);
-    m_cache.insert(std::make_pair(key, CacheEntry(value)));
+    /* atomics and sequence locks are plain integers, so clearing them is fine */
+    memset((void *) snapshot, 0, sizeof(*snapshot));
+    memcpy(snapshot->magic, SnapshotMagic, sizeof(snapshot->magic));
+    snapshot->version = SnapshotVersion;
+    snapshot->entryCount = EntryCount;
+    snapshot->entrySize = sizeof(CacheSlot);
+    /* generations of a new cache must not match the ones of earlier runs;
+     * less than 2^20 changes per second never catch up with this */
+    snapshot->generation.store((uint64_t) time(NULL) << 20);
+}
+
+void
+ValueCache::buildIndex()
+{
+    m_namedEntries.fill(0);
+
+    for (size_t type = 0; type < EmsValue::TypeCount; type++) {
+	if (!*ValueMetadata::typeName((EmsValue::Type) type)) {
+	    continue;
+	}
+	for (size_t subtype = 0; subtype < EmsValue::SubTypeCount; subtype++) {
+	    size_t i = index((EmsValue::Type) type, (EmsValue::SubType) subtype);
+	    m_namedEntries[i / BitsPerWord] |= 1ULL << (i % BitsPerWord);
+	}
+    }
+}
+
+bool
+ValueCache::mapSnapshotFile(const std::string& file)
+{
+    /* make sure the file exists and is large enough for being mapped */
+    {
+	std::fstream stream(file.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+	if (!stream.is_open()) {
+	    stream.open(file.c_str(), std::ios::out | std::ios::binary);
+	}
+	stream.seekp(0, std::ios::end);
+	if (stream && stream.tellp() < (std::streamoff) sizeof(Snapshot)) {
+	    stream.seekp(sizeof(Snapshot) - 1);
+	    stream.put(0);
+	}
+	if (!stream) {
+	    std::cerr << "Could not create cache file " << file << std::endl;
+	    return false;
+	}
+    }
+
+    try {
+	boost::interprocess::file_mapping mapping(file.c_str(), boost::interprocess::read_write);
+	boost::interprocess::mapped_region region(mapping, boost::interprocess::read_write,
+						  0, sizeof(Snapshot));
+	m_snapshotFile.swap(mapping);
+	m_snapshotRegion.swap(region);
+    } catch (boost::interprocess::interprocess_exception& e) {
+	std::cerr << "Failed to map cache file " << file << ": " << e.what() << std::endl;
+	return false;
+    }
+
+    Snapshot *snapshot = (Snapshot *) m_snapshotRegion.get_address();
+    if (memcmp(snapshot->magic, SnapshotMagic, sizeof(snapshot->magic)) != 0 ||
+	    snapshot->version != SnapshotVersion ||
+	    snapshot->entryCount != EntryCount ||
+	    snapshot->entrySize != sizeof(CacheSlot)) {
+	/* new file or one written by an incompatible version */
+	initSnapshot(snapshot);
+    }
+
+    m_snapshot = snapshot;
+    m_localSnapshot.reset();
+    m_changeLogStart = m_snapshot->generation.load();
+
+    for (size_t i = 0; i < EntryCount; i++) {
+	/* a previous instance might have died while writing */
+	m_snapshot->slots[i].lock.reset();
+	if (isOccupied(i)) {
+	    entry(i)->stale = true;
+	    storeLine(i, ValueEnvelope(entry(i)->value).cacheLine());
+	}
+    }
+
+    return true;
+}
+
+void
+ValueCache::handleValues(const EmsValueBatch& values)
+{
+    for (size_t v = 0; v < values.size(); v++) {
+	const EmsValue& value = values.begin()[v];
+	size_t i = index(value.getType(), value.getSubType());
+
+	CacheSlot& slot = m_snapshot->slots[i];
+	/* receiving a stale value again is a change of its state, too */
+	bool changed = !isOccupied(i) || entry(i)->stale || entry(i)->value != value;
+	uint64_t generation;
+	ValueEnvelope::Ptr envelope;
+
+	if (changed) {
+	    generation = m_snapshot->generation.load(std::memory_order_relaxed) + 1;
+	    m_changeLog[generation % EntryCount].store(i, std::memory_order_relaxed);
+	    envelope = ValueEnvelope::get(values, v);
+	} else {
+	    generation = entry(i)->generation;
+	}
+
+	/* entries don't need to be destructed, so just overwrite them */
+	static_assert(std::is_trivially_destructible<CacheEntry>::value, "cache entries need destruction");
+	slot.lock.writeBegin();
+	new (&slot.entry) CacheEntry(value, values.timestamp(), generation);
+	if (changed) {
+	    storeLine(i, envelope->cacheLine());
+	}
+	slot.lock.writeEnd();
+	m_snapshot->occupied[i / BitsPerWord].fetch_or(1ULL << (i % BitsPerWord),
+						       std::memory_order_release);
+	if (changed) {
+	    /* publishes entry and change log slot */
+	    m_snapshot->generation.store(generation, std::memory_order_release);
+	}
+
+	if (m_historySize > 0 && value.hasScalarValue()) {
+	    addHistorySample(i, value, values.timestamp());
+	}
+    }
+}
+
+void
+ValueCache::storeLine(size_t index, boost::string_ref text)
+{
+    RenderedLine& line = m_lines[index];
+    size_t length = std::min(text.size(), LineSize);
+
+    memcpy(line.text, text.data(), length);
+    line.length = length;
+}
+
+void
+ValueCache::addHistorySample(size_t index, const EmsValue& value, time_t timestamp)
+{
+    History *history = m_history[index].load(std::memory_order_relaxed);
+    if (!history) {
+	history = new History(m_historySize);
+	m_history[index].store(history, std::memory_order_release);
+    }
+
+    HistorySample sample = { (uint32_t) timestamp, value.getScalarValue(), value.isValid() };
+
+    history->lock.writeBegin();
+    if (history->count > 0 && m_historyInterval > 0) {
+	/* keep the latest value of each interval */
+	size_t newest = (history->next + m_historySize - 1) % m_historySize;
+	HistorySample& last = history->samples[newest];
+	if (last.timestamp / m_historyInterval == sample.timestamp / m_historyInterval) {
+	    last = sample;
+	    history->lock.writeEnd();
+	    return;
+	}
+    }
+
+    history->samples[history->next] = sample;
+    history->next = (history->next + 1) % m_historySize;
+    if (history->count < m_historySize) {
+	history->count++;
+    }
+    history->lock.writeEnd();
+}
+
+void
+ValueCache::readEntry(size_t index, EntryStorage& copy, RenderedLine *line) const
+{
+    const CacheSlot& slot = m_snapshot->slots[index];
+    uint32_t sequence;
+
+    do {
+	sequence = slot.lock.readBegin();
+	memcpy(&copy, &slot.entry, sizeof(copy));
+	if (line) {
+	    line->length = m_lines[index].length;
+	    memcpy(line->text, m_lines[index].text, line->length);
+	}
+    } while (slot.lock.readRetry(sequence));
+}
+
+bool
+ValueCache::readHistory(size_t index, std::vector<HistorySample>& samples) const
+{
+    const History *history = m_history[index].load(std::memory_order_acquire);
+    if (!history) {
+	return false;
+    }
+
+    uint32_t sequence;
+    do {
+	sequence = history->lock.readBegin();
+	size_t count = history->count;
+	size_t oldest = (history->next + m_historySize - count) % m_historySize;
+
+	/* oldest first */
+	samples.resize(count);
+	for (size_t n = 0; n < count; n++) {
+	    samples[n] = history->samples[(oldest + n) % m_historySize];
+	}
+    } while (history->lock.readRetry(sequence));
+
+    return true;
 }
 
 const EmsValue *
-ValueCache::getValue(EmsValue::Type type, EmsValue::SubType subtype) const
+ValueCache::getValue(EmsValue::Type type, EmsValue::SubType subtype,
+		     time_t *timestamp) const
 {
-    auto iter = m_cache.find(CacheKey(type, subtype));
-    if (iter == m_cache.end()) {
+    size_t i = index(type, subtype);
+    if (!isOccupied(i)) {
 	return NULL;
     }
-    return &iter->second.value;
+    if (timestamp) {
+	*timestamp = entry(i)->timestamp;
+    }
+    return &entry(i)->value;
+}
+
+ValueCache::EntrySet
+ValueCache::selectEntries(const std::vector<std::string>& selector) const
+{
+    EmsValueMask mask;
+    EntrySet result = EntrySet();
+
+    /* invalid selectors match nothing; the API rejects them beforehand */
+    if (!ValueMetadata::selectValues(selector, mask)) {
+	return result;
+    }
+    if (mask.isAll()) {
+	return m_namedEntries;
+    }
+
+    for (size_t type = 0; type < EmsValue::TypeCount; type++) {
+	for (size_t subtype = 0; subtype < EmsValue::SubTypeCount; subtype++) {
+	    if (mask.test((EmsValue::Type) type, (EmsValue::SubType) subtype)) {
+		size_t i = index((EmsValue::Type) type, (EmsValue::SubType) subtype);
+		result[i / BitsPerWord] |= 1ULL << (i % BitsPerWord);
+	    }
+	}
+    }
+    for (size_t word = 0; word < OccupiedWords; word++) {
+	result[word] &= m_namedEntries[word];
+    }
+
+    return result;
+}
+
+void
+ValueCache::outputEntry(const CacheEntry& cached, const RenderedLine& line,
+			std::ostream& stream) const
+{
+    stream.write(line.text, line.length);
+    stream << " | " << cached.timestamp;
+    if (cached.stale) {
+	stream << " | stale";
+    }
+    stream << '\n';
 }
 
 void
 ValueCache::outputValues(const std::vector<std::string>& selector, std::ostream& stream)
 {
-    for (auto& entry: m_cache) {
-	std::string type = ValueApi::getTypeName(entry.first.m_type);
-	if (type.empty()) {
-	    continue;
+    EntrySet selected = selectEntries(selector);
+    RenderedLine line;
+
+    for (size_t word = 0; word < OccupiedWords; word++) {
+	uint64_t bits = selected[word] & m_snapshot->occupied[word].load(std::memory_order_acquire);
+	for (; bits; bits &= bits - 1) {
+	    size_t i = word * BitsPerWord + __builtin_ctzll(bits);
+	    EntryStorage copy;
+	    readEntry(i, copy, &line);
+	    outputEntry(*reinterpret_cast<const CacheEntry *>(&copy), line, stream);
+	}
+    }
+}
+
+uint64_t
+ValueCache::outputChanges(const std::vector<std::string>& selector, uint64_t since,
+			  std::ostream& stream)
+{
+    uint64_t current = m_snapshot->generation.load(std::memory_order_acquire);
+    if (since == current) {
+	return current;
+    }
+    if (since > current) {
+	/* not one of ours, e.g. of a cache file replaced meanwhile */
+	since = 0;
+    }
+
+    EntrySet selected = selectEntries(selector);
+    RenderedLine line;
+
+    /* the change log avoids looking at all entries if it covers the range */
+    if (since >= m_changeLogStart && current - since <= EntryCount) {
+	EntrySet changed = EntrySet();
+	for (uint64_t generation = since + 1; generation <= current; generation++) {
+	    size_t i = m_changeLog[generation % EntryCount].load(std::memory_order_relaxed);
+	    changed[i / BitsPerWord] |= 1ULL << (i % BitsPerWord);
 	}
+	/* the slots might have been reused while reading them */
+	if (m_snapshot->generation.load(std::memory_order_acquire) - since <= EntryCount) {
+	    for (size_t word = 0; word < OccupiedWords; word++) {
+		selected[word] &= changed[word];
+	    }
+	}
+    }
 
-	std::string subtype = ValueApi::getSubTypeName(entry.first.m_subtype);
-	bool matchesSelector = false;
+    for (size_t word = 0; word < OccupiedWords; word++) {
+	uint64_t bits = selected[word] & m_snapshot->occupied[word].load(std::memory_order_acquire);
+	for (; bits; bits &= bits - 1) {
+	    size_t i = word * BitsPerWord + __builtin_ctzll(bits);
+	    EntryStorage copy;
+	    readEntry(i, copy, &line);
 
-	if (selector.size() >= 1) {
-	    if (selector[0] == type) {
-		matchesSelector = true;
-	    } else if (selector[0] == subtype || (selector[0] == "none" && subtype.empty())) {
-		if (selector.size() == 1) {
-		    matchesSelector = true;
-		} else if (selector[1] == type) {
-		    matchesSelector = true;
-		}
+	    const CacheEntry *cached = reinterpret_cast<const CacheEntry *>(&copy);
+	    if (cached->generation > since) {
+		outputEntry(*cached, line, stream);
 	    }
-	} else {
-	    // no selector matches everything
-	    matchesSelector = true;
 	}
-	if (!matchesSelector) {
-	    continue;
+    }
+
+    return current;
+}
+
+uint64_t
+ValueCache::outputJson(const std::vector<std::string>& selector, std::ostream& stream)
+{
+    /* read before the entries, so the document contains at least this generation */
+    uint64_t generation = m_snapshot->generation.load(std::memory_order_acquire);
+    EntrySet selected = selectEntries(selector);
+    char buffer[ValueApi::MaxFormattedLength];
+    std::string text;
+    bool first = true;
+
+    stream << "{\"generation\":" << generation << ",\"values\":[";
+    for (size_t word = 0; word < OccupiedWords; word++) {
+	uint64_t bits = selected[word] & m_snapshot->occupied[word].load(std::memory_order_acquire);
+	for (; bits; bits &= bits - 1) {
+	    size_t i = word * BitsPerWord + __builtin_ctzll(bits);
+	    EntryStorage copy;
+	    readEntry(i, copy);
+
+	    const CacheEntry *cached = reinterpret_cast<const CacheEntry *>(&copy);
+	    const EmsValue& value = cached->value;
+	    size_t length = ValueApi::formatValue(value, buffer);
+
+	    text = first ? "\n{" : ",\n{";
+	    ValueApi::appendJsonFields(text, ValueMetadata::subTypeName(value.getSubType()),
+				       ValueMetadata::typeName(value.getType()),
+				       boost::string_ref(buffer, length));
+	    stream << text << ",\"timestamp\":" << cached->timestamp;
+	    if (cached->stale) {
+		stream << ",\"stale\":true";
+	    }
+	    stream << '}';
+	    first = false;
 	}
+    }
+    stream << "\n]}\n";
+
+    return generation;
+}
+
+void
+ValueCache::outputHistory(const std::vector<std::string>& selector, time_t since,
+			  std::ostream& stream)
+{
+    EntrySet selected = selectEntries(selector);
+    std::vector<HistorySample> samples;
+
+    for (size_t word = 0; word < OccupiedWords; word++) {
+	uint64_t bits = selected[word] & m_snapshot->occupied[word].load(std::memory_order_acquire);
+	for (; bits; bits &= bits - 1) {
+	    size_t i = word * BitsPerWord + __builtin_ctzll(bits);
+	    if (!readHistory(i, samples)) {
+		continue;
+	    }
+
+	    /* the samples only hold the value, the rest comes from the current one */
+	    EntryStorage copy;
+	    readEntry(i, copy);
+	    const EmsValue& current = reinterpret_cast<const CacheEntry *>(&copy)->value;
+	    const char *type = ValueMetadata::typeName(current.getType());
+	    const char *subtype = ValueMetadata::subTypeName(current.getSubType());
 
-	if (!subtype.empty()) {
-	    stream << subtype << " ";
+	    for (auto& sample : samples) {
+		if ((time_t) sample.timestamp < since) {
+		    continue;
+		}
+
+		if (*subtype) {
+		    stream << subtype << " ";
+		}
+		stream << type << " = "
+		       << ValueApi::formatValue(current.withScalarValue(sample.value, sample.valid));
+		stream << " | " << sample.timestamp << '\n';
+	    }
 	}
-	stream << type << " = " << ValueApi::formatValue(entry.second.value);
-	stream << " | " << entry.second.timestamp << '\n';
     }
 }
@@ -21,49 +21,165 @@
 #define __VALUECACHE_H__
 
 #include <time.h>
-#include <map>
+#include <array>
+#include <atomic>
+#include <memory>
 #include <ostream>
+#include <type_traits>
 #include <vector>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/utility/string_ref.hpp>
 #include "EmsMessage.h"
+#include "SeqLock.h"
 
+/*
+ * Values are written by a single thread (the one calling handleValues()),
+ * but outputValues() and outputHistory() may be called from any thread
+ * without blocking it, see SeqLock.
+ */
 class ValueCache
 {
     public:
-	ValueCache();
+	/* historySize samples are kept per value, at most one per historyInterval */
+	ValueCache(size_t historySize = 0, unsigned int historyInterval = 0);
 	~ValueCache();
 
-	void handleValue(const EmsValue& value);
+	/* keep the values in the given file, reusing the ones it already contains */
+	bool mapSnapshotFile(const std::string& file);
+
+	void handleValues(const EmsValueBatch& values);
 	void outputValues(const std::vector<std::string>& selector, std::ostream& stream);
-	const EmsValue * getValue(EmsValue::Type type, EmsValue::SubType subtype) const;
+	/* outputs the values changed after the given generation, returns the current one */
+	uint64_t outputChanges(const std::vector<std::string>& selector, uint64_t since,
+			       std::ostream& stream);
+	void outputHistory(const std::vector<std::string>& selector, time_t since,
+			   std::ostream& stream);
+	/* outputs the values as JSON document, returns the generation it reflects */
+	uint64_t outputJson(const std::vector<std::string>& selector, std::ostream& stream);
+	/* incremented on every change of a value, for all threads */
+	uint64_t generation() const {
+	    return m_snapshot->generation.load(std::memory_order_acquire);
+	}
+	/* only to be used by the writing thread */
+	const EmsValue * getValue(EmsValue::Type type, EmsValue::SubType subtype,
+				  time_t *timestamp = NULL) const;
 
     private:
-	class CacheKey {
-	    public:
-		CacheKey(EmsValue::Type type, EmsValue::SubType subtype) :
-		    m_type(type), m_subtype(subtype) { }
-		bool operator=(const CacheKey& rhs) {
-		    return m_type == rhs.m_type && m_subtype == rhs.m_subtype;
-		}
-		bool operator<(const CacheKey& rhs) const {
-		    if (m_type != rhs.m_type) {
-			return m_type < rhs.m_type;
-		    }
-		    return m_subtype < rhs.m_subtype;
-		}
-
-		EmsValue::Type m_type;
-		EmsValue::SubType m_subtype;
-	};
-
 	struct CacheEntry {
 	    time_t timestamp;
+	    /* generation of the last change of the value */
+	    uint64_t generation;
 	    EmsValue value;
+	    /* loaded from the snapshot file and not received again yet */
+	    bool stale;
+
+	    CacheEntry(const EmsValue& v, time_t t, uint64_t g) :
+		timestamp(t), generation(g), value(v), stale(false) { }
+	};
+	typedef std::aligned_storage<sizeof(CacheEntry), alignof(CacheEntry)>::type EntryStorage;
+
+	struct CacheSlot {
+	    SeqLock lock;
+	    EntryStorage entry;
+	};
+
+	struct HistorySample {
+	    uint32_t timestamp;
+	    int32_t value;
+	    bool valid;
+	};
+
+	/* ring buffer of the latest samples of a single value */
+	struct History {
+	    SeqLock lock;
+	    std::vector<HistorySample> samples;
+	    size_t next;
+	    size_t count;
 
-	    CacheEntry(const EmsValue& v) :
-		timestamp(time(NULL)), value(v) { }
+	    History(size_t size) :
+		samples(size), next(0), count(0) { }
 	};
 
-	std::map<CacheKey, CacheEntry> m_cache;
+	static const size_t EntryCount = EmsValue::TypeCount * EmsValue::SubTypeCount;
+	static const size_t BitsPerWord = 64;
+	static const size_t OccupiedWords = (EntryCount + BitsPerWord - 1) / BitsPerWord;
+
+	/* layout of the snapshot file, any change requires a version bump */
+	struct Snapshot {
+	    char magic[4];
+	    uint32_t version;
+	    /* change with the EmsValue enums and layout */
+	    uint32_t entryCount;
+	    uint32_t entrySize;
+	    /* incremented on every value change */
+	    std::atomic<uint64_t> generation;
+	    std::atomic<uint64_t> occupied[OccupiedWords];
+	    /* indexed by (type, subtype), so entries never move */
+	    CacheSlot slots[EntryCount];
+	};
+
+	/*
+	 * 'subtype type = value', rendered whenever the value changes;
+	 * guarded by the lock of the slot with the same index
+	 */
+	static const size_t LineSize = 128;
+	struct RenderedLine {
+	    uint8_t length;
+	    char text[LineSize];
+
+	    RenderedLine() :
+		length(0) { }
+	};
+
+	/* bitmap of entry indices */
+	typedef std::array<uint64_t, OccupiedWords> EntrySet;
+
+	static const char SnapshotMagic[4];
+	static const uint32_t SnapshotVersion = 3;
+
+	static size_t index(EmsValue::Type type, EmsValue::SubType subtype) {
+	    return type * EmsValue::SubTypeCount + subtype;
+	}
+	bool isOccupied(size_t index) const {
+	    uint64_t word = m_snapshot->occupied[index / BitsPerWord].load(std::memory_order_acquire);
+	    return word & (1ULL << (index % BitsPerWord));
+	}
+	/* direct access, for the writing thread only */
+	CacheEntry * entry(size_t index) const {
+	    return reinterpret_cast<CacheEntry *>(&m_snapshot->slots[index].entry);
+	}
+	/* consistent copy of an occupied entry (and its line), for all threads */
+	void readEntry(size_t index, EntryStorage& copy, RenderedLine *line = NULL) const;
+	bool readHistory(size_t index, std::vector<HistorySample>& samples) const;
+
+	void outputEntry(const CacheEntry& cached, const RenderedLine& line,
+			 std::ostream& stream) const;
+
+	void initSnapshot(Snapshot *snapshot);
+	void buildIndex();
+	void storeLine(size_t index, boost::string_ref text);
+	void addHistorySample(size_t index, const EmsValue& value, time_t timestamp);
+	/* entries possibly matching the selector, regardless of being occupied */
+	EntrySet selectEntries(const std::vector<std::string>& selector) const;
+
+    private:
+	Snapshot *m_snapshot;
+	/* used if no snapshot file is mapped */
+	std::unique_ptr<Snapshot> m_localSnapshot;
+	boost::interprocess::file_mapping m_snapshotFile;
+	boost::interprocess::mapped_region m_snapshotRegion;
+	/* allocated on the first sample of a value */
+	std::vector<std::atomic<History *> > m_history;
+	size_t m_historySize;
+	unsigned int m_historyInterval;
+	std::vector<RenderedLine> m_lines;
+	/* index of the entry changed in generation g, at g % EntryCount */
+	std::vector<std::atomic<uint32_t> > m_changeLog;
+	/* generations up to this one happened before startup and aren't logged */
+	uint64_t m_changeLogStart;
+	/* values of types without name are never output */
+	EntrySet m_namedEntries;
 };
 
 #endif /* __VALUECACHE_H__ */
@@ -0,0 +1,117 @@
+/*
+ * Buderus EMS data collector
+ *
+ * Copyright (C) 2011 Danny Baumann <dannybaumann@web.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <boost/make_shared.hpp>
+#include "ValueApi.h"
+#include "ValueEnvelope.h"
+#include "ValueMetadata.h"
+
+static void
+appendBigEndian(std::string& out, uint32_t value, size_t size)
+{
+    while (size-- > 0) {
+	out += (char) (value >> (8 * size));
+    }
+}
+
+ValueEnvelope::ValueEnvelope(const EmsValue& value, time_t timestamp) :
+    m_type(value.getType()),
+    m_subType(value.getSubType()),
+    m_typeName(ValueMetadata::typeName(value.getType())),
+    m_subTypeName(ValueMetadata::subTypeName(value.getSubType()))
+{
+    char buffer[ValueApi::MaxFormattedLength];
+    size_t valueLength = ValueApi::formatValue(value, buffer);
+    size_t typeLength = strlen(m_typeName);
+    size_t subTypeLength = strlen(m_subTypeName);
+    size_t nameLength = typeLength + (subTypeLength ? subTypeLength + 1 : 0);
+
+    m_text.reserve(4 * valueLength + 2 * nameLength + 2 * (subTypeLength + typeLength) +
+		   RecordSize + 70);
+    m_text.assign(buffer, valueLength);
+
+    m_dataLineStart = m_text.size();
+    if (typeLength) {
+	if (subTypeLength) {
+	    m_text.append(m_subTypeName, subTypeLength);
+	    m_text += ' ';
+	}
+	m_text.append(m_typeName, typeLength);
+	m_text += ' ';
+	m_text.append(buffer, valueLength);
+	m_text += '\n';
+    }
+
+    m_cacheLineStart = m_text.size();
+    if (typeLength) {
+	/* same name as the data line */
+	m_text.append(m_text, m_dataLineStart, nameLength);
+	m_text += " = ";
+	m_text.append(buffer, valueLength);
+    }
+
+    m_topicStart = m_text.size();
+    m_text += "sensor/";
+    if (subTypeLength) {
+	m_text.append(m_subTypeName, subTypeLength);
+	m_text += '/';
+    }
+    if (typeLength) {
+	m_text.append(m_typeName, typeLength);
+	m_text += '/';
+    }
+    m_text += "value";
+
+    m_eventStart = m_text.size();
+    if (typeLength) {
+	m_text += "data: {";
+	ValueApi::appendJsonFields(m_text, m_subTypeName, m_typeName,
+				   boost::string_ref(buffer, valueLength));
+	m_text += "}\n\n";
+    }
+
+    m_recordStart = m_text.size();
+    if (typeLength && value.hasScalarValue()) {
+	bool numeric = value.getReadingType() == EmsValue::Numeric;
+	appendBigEndian(m_text, m_type, 1);
+	appendBigEndian(m_text, m_subType, 1);
+	appendBigEndian(m_text, value.getReadingType(), 1);
+	appendBigEndian(m_text, value.isValid() ? RecordValid : 0, 1);
+	appendBigEndian(m_text, numeric ? value.getDivider() : 1, 2);
+	appendBigEndian(m_text, 0, 2);
+	appendBigEndian(m_text, value.getScalarValue(), 4);
+	appendBigEndian(m_text, timestamp, 4);
+    }
+}
+
+ValueEnvelope::Ptr
+ValueEnvelope::get(const EmsValueBatch& values, size_t index)
+{
+    const EmsValue& value = values.begin()[index];
+    EmsValueBatch::EnvelopePtr *envelopes = values.envelopes();
+
+    if (!envelopes) {
+	return boost::make_shared<ValueEnvelope>(value, values.timestamp());
+    }
+    if (!envelopes[index]) {
+	envelopes[index] = boost::make_shared<ValueEnvelope>(value, values.timestamp());
+    }
+    return envelopes[index];
+}
@@ -0,0 +1,114 @@
+/*
+ * Buderus EMS data collector
+ *
+ * Copyright (C) 2011 Danny Baumann <dannybaumann@web.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VALUEENVELOPE_H__
+#define __VALUEENVELOPE_H__
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility/string_ref.hpp>
+#include "EmsMessage.h"
+#include "Noncopyable.h"
+
+/*
+ * Everything the sinks output for a single value. It is formatted once,
+ * when the first sink asks for it, and then shared by all sinks and
+ * connections. Envelopes are never modified after creation.
+ */
+class ValueEnvelope : private boost::noncopyable
+{
+    public:
+	typedef boost::shared_ptr<const ValueEnvelope> Ptr;
+	typedef std::vector<Ptr> List;
+
+    public:
+	/* binary records of the data port, all fields in network byte order:
+	 *   0  uint8   type id
+	 *   1  uint8   subtype id
+	 *   2  uint8   reading type
+	 *   3  uint8   flags (RecordValid)
+	 *   4  uint16  divider, the reading is value / divider
+	 *   6  uint16  reserved, 0
+	 *   8  int32   value
+	 *   12 uint32  timestamp */
+	static const size_t RecordSize = 16;
+	static const uint8_t RecordValid = 1 << 0;
+
+    public:
+	ValueEnvelope(const EmsValue& value, time_t timestamp = 0);
+
+	/* the envelope of the value at index, created if the batch has none yet */
+	static Ptr get(const EmsValueBatch& values, size_t index);
+
+    public:
+	EmsValue::Type type() const {
+	    return m_type;
+	}
+	EmsValue::SubType subType() const {
+	    return m_subType;
+	}
+	/* API names, empty if there is none */
+	const char * typeName() const {
+	    return m_typeName;
+	}
+	const char * subTypeName() const {
+	    return m_subTypeName;
+	}
+	/* the formatted value, also used as MQTT payload */
+	boost::string_ref value() const {
+	    return boost::string_ref(m_text.data(), m_dataLineStart);
+	}
+	/* '[subtype ]type value\n' as sent on the data port, empty without type name */
+	boost::string_ref dataLine() const {
+	    return boost::string_ref(m_text.data() + m_dataLineStart,
+				     m_cacheLineStart - m_dataLineStart);
+	}
+	/* '[subtype ]type = value' as output by the value cache, empty without type name */
+	boost::string_ref cacheLine() const {
+	    return boost::string_ref(m_text.data() + m_cacheLineStart,
+				     m_topicStart - m_cacheLineStart);
+	}
+	/* MQTT topic below the configured prefix: 'sensor/[subtype/][type/]value' */
+	boost::string_ref topic() const {
+	    return boost::string_ref(m_text.data() + m_topicStart, m_eventStart - m_topicStart);
+	}
+	/* server-sent event with the value as JSON object, empty without type name */
+	boost::string_ref event() const {
+	    return boost::string_ref(m_text.data() + m_eventStart, m_recordStart - m_eventStart);
+	}
+	/* binary record, empty without type name or scalar value */
+	boost::string_ref record() const {
+	    return boost::string_ref(m_text.data() + m_recordStart, m_text.size() - m_recordStart);
+	}
+
+    private:
+	EmsValue::Type m_type;
+	EmsValue::SubType m_subType;
+	const char *m_typeName;
+	const char *m_subTypeName;
+	/* all of the above back to back, so an envelope needs only two allocations */
+	std::string m_text;
+	size_t m_dataLineStart;
+	size_t m_cacheLineStart;
+	size_t m_topicStart;
+	size_t m_eventStart;
+	size_t m_recordStart;
+};
+
+#endif /* __VALUEENVELOPE_H__ */
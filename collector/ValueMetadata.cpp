@@ -0,0 +1,445 @@
+/*
+ * Buderus EMS data collector
+ *
+ * Copyright (C) 2011 Danny Baumann <dannybaumann@web.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <vector>
+#include "ValueMetadata.h"
+
+using namespace ValueMetadata;
+
+static constexpr EnumLabel WWSYSTEMLABELS[] = {
+    { EmsProto::WWSystemNone, "none", "keins" },
+    { EmsProto::WWSystemDurchlauf, "tankless", "Durchlauferhitzer" },
+    { EmsProto::WWSystemKlein, "small", "klein" },
+    { EmsProto::WWSystemGross, "large", "groß" },
+    { EmsProto::WWSystemSpeicherlade, "speicherladesystem", "Speicherladesystem" },
+    { 0, NULL, NULL }
+};
+
+static constexpr EnumLabel ZIRKSPLABELS[] = {
+    { 0, "off", "aus" },
+    { 1, "1x", "1x 3min" }, { 2, "2x", "2x 3min" }, { 3, "3x", "3x 3min" },
+    { 4, "4x", "4x 3min" }, { 5, "5x", "5x 3min" }, { 6, "6x", "6x 3min" },
+    { 7, "alwayson", "dauerhaft an" },
+    { 0, NULL, NULL }
+};
+
+static constexpr EnumLabel MAINTENANCEMESSAGESLABELS[] = {
+    { 0, "off", "keine" },
+    { 1, "byhours", "nach Betriebsstunden" },
+    { 2, "bydate", "nach Datum" },
+    { 0, NULL, NULL }
+};
+
+static constexpr EnumLabel MAINTENANCENEEDEDLABELS[] = {
+    { 0, "no", "nein" },
+    { 3, "byhours", "ja, wegen Betriebsstunden" },
+    { 8, "bydate", "ja, wegen Datum" },
+    { 0, NULL, NULL }
+};
+
+static constexpr EnumLabel ERRORTYPELABELS[] = {
+    { 0x10, "L", "Verriegelnder Fehler" },
+    { 0x11, "B", "Blockierender Fehler" },
+    { 0x12, "S", "Anlagenfehler" },
+    { 0x13, "D", "Zurückgesetzter Anlagenfehler" },
+    { 0, NULL, NULL }
+};
+
+static constexpr EnumLabel OPMODELABELS[] = {
+    { 0, "off", "ständig aus" }, { 1, "on", "ständig an" }, { 2, "auto", "Automatik" },
+    { 0, NULL, NULL }
+};
+
+static constexpr EnumLabel HKOPMODELABELS[] = {
+    { 0, "night", "immer Nachtbetrieb" }, { 1, "day", "immer Tagbetrieb" }, { 2, "auto", "Automatik" },
+    { 0, NULL, NULL }
+};
+
+constexpr EnumLabel ValueMetadata::WEEKDAYS[] = {
+    { 0, "monday", "Montag" }, { 1, "tuesday", "Dienstag" }, { 2, "wednesday", "Mittwoch" },
+    { 3, "thursday", "Donnerstag" }, { 4, "friday", "Freitag" }, { 5, "saturday", "Samstag" },
+    { 6, "sunday", "Sonntag" }, { 7, "everyday", NULL },
+    { 0, NULL, NULL }
+};
+
+static constexpr EnumLabel BUILDINGTYPELABELS[] = {
+    { 0, "light", "leicht" }, { 1, "medium", "mittel" }, { 2, "heavy", "schwer" },
+    { 0, NULL, NULL }
+};
+
+static constexpr EnumLabel HEATINGTYPELABELS[] = {
+    { 0, "none", NULL }, { 1, "heater", "Heizkörper" },
+    { 2, "convection", "Konvektor" }, { 3, "floorheater", "Fußboden" },
+    { 0, NULL, NULL }
+};
+
+static constexpr EnumLabel REDUCTIONMODELABELS[] = {
+    { 0, "offmode", "Abschalt" }, { 1, "reduced", "Reduziert" },
+    { 2, "raumhalt", "Raumhalt" }, { 3, "aussenhalt", "Außenhalt" },
+    { 0, NULL, NULL }
+};
+
+static constexpr EnumLabel FROSTPROTECTLABELS[] = {
+    { 0, "off", "kein" }, { 1, "byoutdoortemp", "Außentemperatur" },
+    { 2, "byindoortemp", "Raumtemperatur 5 Grad" },
+    { 0, NULL, NULL }
+};
+
+static constexpr EnumLabel RELEVANTVALUELABELS[] = {
+    { 0, "outdoor", "außentemperaturgeführt" }, { 1, "indoor", "raumtemperaturgeführt" },
+    { 0, NULL, NULL }
+};
+
+static constexpr EnumLabel VACATIONREDUCTIONLABELS[] = {
+    { 3, "outdoor", "Außenhalt" }, { 2, "indoor", "Raumhalt" },
+    { 0, NULL, NULL }
+};
+
+static constexpr EnumLabel REMOTETYPELABELS[] = {
+    { 0, "none", "Keine" }, { 1, "rc20", "RC20" }, { 2, "rc3x", "RC3x" },
+    { 0, NULL, NULL }
+};
+
+/* in enum order, checked below */
+constexpr TypeInfo ValueMetadata::TYPES[] = {
+    { EmsValue::SollTemp, "targettemperature", "Solltemperatur", "°C", NULL },
+    { EmsValue::IstTemp, "currenttemperature", "Isttemperatur", "°C", NULL },
+    { EmsValue::SetTemp, "settemperature", "Temperatureinstellung", "°C", NULL },
+    { EmsValue::MinTemp, "mintemperature", "Minimale Temperatur", "°C", NULL },
+    { EmsValue::MaxTemp, "maxtemperature", "Maximale Temperatur", "°C", NULL },
+    { EmsValue::TagTemp, "daytemperature", "Tagtemperatur", "°C", NULL },
+    { EmsValue::NachtTemp, "nighttemperature", "Nachttemperatur", "°C", NULL },
+    { EmsValue::UrlaubTemp, "vacationtemperature", "Urlaubstemperatur", "°C", NULL },
+    { EmsValue::RaumSollTemp, "roomtargettemperature", "Raum-Solltemperatur", "°C", NULL },
+    { EmsValue::RaumIstTemp, "roomcurrenttemperature", "Raum-Isttemperatur", "°C", NULL },
+    { EmsValue::RaumEinfluss, "maxroomeffect", "Max. Raumeinfluss", "K", NULL },
+    { EmsValue::RaumOffset, "roomtemperatureoffset", "Raumoffset", "K", NULL },
+    { EmsValue::GedaempfteTemp, "dampedtemperature", "Temperatur (gedämpft)", "°C", NULL },
+    { EmsValue::DesinfektionsTemp, "desinfectiontemperature", "Desinfektionstemperatur", "°C", NULL },
+    { EmsValue::RaumTemperaturAenderung, "roomtemperaturechange", "Raumtemperaturänderung", "K/min", NULL },
+    { EmsValue::Mischersteuerung, "mixercontrol", "Mischersteuerung", NULL, NULL },
+    { EmsValue::Flammenstrom, "flamecurrent", "Flammenstrom", "µA", NULL },
+    { EmsValue::Systemdruck, "pressure", "Systemdruck", "bar", NULL },
+    { EmsValue::IstModulation, "currentmodulation", "Istwert Modulation", "%", NULL },
+    { EmsValue::MinModulation, "minmodulation", "Min. Modulation", "%", NULL },
+    { EmsValue::MaxModulation, "maxmodulation", "Max. Modulation", "%", NULL },
+    { EmsValue::SollModulation, "targetmodulation", "Sollwert Modulation", "%", NULL },
+    { EmsValue::SollLeistung, "requestedpower", "Angeforderte Leistung", "%", NULL },
+    { EmsValue::EinschaltHysterese, "onhysteresis", "Einschalthysterese", "K", NULL },
+    { EmsValue::AusschaltHysterese, "offhysteresis", "Abschalthysterese", "K", NULL },
+    { EmsValue::SchwelleSommerWinter, "summerwinterthreshold", "Schwelle Sommer/Winter", "°C", NULL },
+    { EmsValue::FrostSchutzTemp, "frostprotecttemperature", "Frostschutztemperatur", "°C", NULL },
+    { EmsValue::AuslegungsTemp, "designtemperature", "Auslegungstemperatur", "°C", NULL },
+    { EmsValue::RaumUebersteuerTemp, "temperatureoverride", "Temporäre Raumtemperaturübersteuerung", "°C", NULL },
+    { EmsValue::AbsenkungsSchwellenTemp, "reducedmodethreshold", "Schwellentemperatur Außenhaltbetrieb", "°C", NULL },
+    { EmsValue::UrlaubAbsenkungsSchwellenTemp, "vacationreducedmodethreshold", "Schwellentemperatur Außenhaltbetrieb Urlaub", "°C", NULL },
+    { EmsValue::AbsenkungsAbbruchTemp, "cancelreducedmodethreshold", "Nachtabsenkung abbrechen unterhalb", "°C", NULL },
+    { EmsValue::DurchflussMenge, "flowrate", "Durchflussmenge", "l/min", NULL },
+    { EmsValue::BetriebsZeit, "operatingminutes", "Betriebszeit", "min", NULL },
+    { EmsValue::BetriebsZeit2, "operatingminutes2", "Betriebszeit 2", "min", NULL },
+    { EmsValue::HeizZeit, "heatingminutes", "Heizzeit", "min", NULL },
+    { EmsValue::WarmwasserbereitungsZeit, "warmwaterminutes", "WW-Bereitungszeit", "min", NULL },
+    { EmsValue::Brennerstarts, "heaterstarts", "Brennerstarts", NULL, NULL },
+    { EmsValue::WarmwasserBereitungen, "warmwaterpreparations", "WW-Bereitungen ", NULL, NULL },
+    { EmsValue::DesinfektionStunde, "desinfectionhour", "Thermische Desinfektion Stunde", "h", NULL },
+    { EmsValue::HektoStundenVorWartung, "maintenanceintervalin100hours", "Wartungsintervall in 100h", NULL, NULL },
+    { EmsValue::EinschaltoptimierungsZeit, "onoptimizationminutes", "Einschaltoptimierungszeit", "min", NULL },
+    { EmsValue::AusschaltoptimierungsZeit, "offoptimizationminutes", "Abschaltoptimierungszeit", "min", NULL },
+    { EmsValue::AntipendelZeit, "antipendelminutes", "Antipendelzeit", "min", NULL },
+    { EmsValue::NachlaufZeit, "followupminutes", "Nachlaufzeit", "min", NULL },
+    { EmsValue::PartyZeit, "partyhours", "restl. Partyzeit", "h", NULL },
+    { EmsValue::PausenZeit, "pausehours", "restl. Pausenzeit", "h", NULL },
+    { EmsValue::FlammeAktiv, "flameactive", "Flamme", NULL, NULL },
+    { EmsValue::BrennerAktiv, "heateractive", "Brenner", NULL, NULL },
+    { EmsValue::ZuendungAktiv, "ignitionactive", "Zündung", NULL, NULL },
+    { EmsValue::PumpeAktiv, "pumpactive", "Pumpe", NULL, NULL },
+    { EmsValue::ZirkulationAktiv, "zirkpumpactive", "Zirkulation", NULL, NULL },
+    { EmsValue::DreiWegeVentilAufWW, "3wayonww", "3-Wege-Ventil auf WW", NULL, NULL },
+    { EmsValue::EinmalLadungAktiv, "onetimeload", "Einmalladung", NULL, NULL },
+    { EmsValue::DesinfektionAktiv, "desinfectionactive", "Therm. Desinfektion", NULL, NULL },
+    { EmsValue::NachladungAktiv, "boostcharge", "Nachladung", NULL, NULL },
+    { EmsValue::WarmwasserBereitung, "warmwaterpreparationactive", "WW-Bereitung", NULL, NULL },
+    { EmsValue::WarmwasserTempOK, "warmwatertempok", "WW-Temperatur OK", NULL, NULL },
+    { EmsValue::Tagbetrieb, "daymode", "Tagbetrieb", NULL, NULL },
+    { EmsValue::Sommerbetrieb, "summermode", "Sommerbetrieb", NULL, NULL },
+    { EmsValue::Ausschaltoptimierung, "offoptimization", "Ausschaltoptimierung", NULL, NULL },
+    { EmsValue::Einschaltoptimierung, "onoptimization", "Einschaltoptimierung", NULL, NULL },
+    { EmsValue::Estrichtrocknung, "floordrying", "Estrichtrocknung", NULL, NULL },
+    { EmsValue::WWVorrang, "wwoverride", "WW-Vorrang", NULL, NULL },
+    { EmsValue::Ferien, "holidaymode", "Ferienbetrieb", NULL, NULL },
+    { EmsValue::Urlaub, "vacationmode", "Urlaubsbetrieb", NULL, NULL },
+    { EmsValue::Party, "partymode", "Partybetrieb", NULL, NULL },
+    { EmsValue::Pause, "pausemode", "Pausebetrieb", NULL, NULL },
+    { EmsValue::Frostschutzbetrieb, "frostprotectmodeactive", "Frostschutzbetrieb", NULL, NULL },
+    { EmsValue::SchaltuhrEin, "switchpointactive", "Schaltuhr aktiv", NULL, NULL },
+    { EmsValue::KesselSchalter, "masterswitch", "per Kesselschalter freigegeben", NULL, NULL },
+    { EmsValue::EigenesProgrammAktiv, "customschedule", "Eigenes Programm aktiv", NULL, NULL },
+    { EmsValue::Desinfektion, "desinfection", "Thermische Desinfektion", NULL, NULL },
+    { EmsValue::EinmalLadungsLED, "onetimeloadindicator", "Einmalladungs-LED", NULL, NULL },
+    { EmsValue::ATDaempfung, "outdoortempdamping", "Dämpfung Außentemperatur", NULL, NULL },
+    { EmsValue::SchaltzeitOptimierung, "scheduleoptimizer", "Schaltzeitoptimierung", NULL, NULL },
+    { EmsValue::Fuehler1Defekt, "sensor1failure", "Fühler 1 defekt", NULL, NULL },
+    { EmsValue::Fuehler2Defekt, "sensor2failure", "Fühler 2 defekt", NULL, NULL },
+    { EmsValue::Stoerung, "failure", "Störung", NULL, NULL },
+    { EmsValue::StoerungDesinfektion, "desinfectionfailure", "Störung Desinfektion", NULL, NULL },
+    { EmsValue::Ladevorgang, "loading", "Ladevorgang", NULL, NULL },
+    { EmsValue::WWSystemType, "warmwatersystemtype", "WW-System-Typ", NULL, WWSYSTEMLABELS },
+    { EmsValue::Schaltpunkte, "switchpoints", "Schaltpunkte", NULL, ZIRKSPLABELS },
+    { EmsValue::Wartungsmeldungen, "maintenancereminder", "Wartungsmeldungen", NULL, MAINTENANCEMESSAGESLABELS },
+    { EmsValue::WartungFaellig, "maintenancedue", "Wartung fällig?", NULL, MAINTENANCENEEDEDLABELS },
+    { EmsValue::Betriebsart, "opmode", "Betriebsart", NULL, OPMODELABELS },
+    { EmsValue::DesinfektionTag, "desinfectionday", "Thermische Desinfektion Tag", NULL, WEEKDAYS },
+    { EmsValue::GebaeudeArt, "buildingtype", "Gebäudeart", NULL, BUILDINGTYPELABELS },
+    { EmsValue::AbsenkModus, "reductionmode", "Absenk-Modus", NULL, REDUCTIONMODELABELS },
+    { EmsValue::HeizSystem, "heatingsystem", "Heizsystem", NULL, HEATINGTYPELABELS },
+    { EmsValue::FuehrungsGroesse, "relevantparameter", "Führungsgröße", NULL, RELEVANTVALUELABELS },
+    { EmsValue::UrlaubAbsenkungsArt, "vacationreductionmode", "Urlaubsabsenkungsart", NULL, VACATIONREDUCTIONLABELS },
+    { EmsValue::Frostschutz, "frostprotectmode", "Frostschutz", NULL, FROSTPROTECTLABELS },
+    { EmsValue::FBTyp, "remotecontroltype", "Fernbedienungstyp", NULL, REMOTETYPELABELS },
+    { EmsValue::HKKennlinie, "characteristic", "Kennlinie", NULL, NULL },
+    { EmsValue::Fehler, "error", "Fehler", NULL, ERRORTYPELABELS },
+    { EmsValue::SystemZeit, "systemtime", "Systemzeit", NULL, NULL },
+    { EmsValue::Wartungstermin, "maintenancedate", "Wartungstermin", NULL, NULL },
+    { EmsValue::ServiceCode, "servicecode", "Servicecode", NULL, NULL },
+    { EmsValue::FehlerCode, "errorcode", "Fehlercode", NULL, NULL }
+};
+
+constexpr SubTypeInfo ValueMetadata::SUBTYPES[] = {
+    { EmsValue::None, "", NULL },
+    { EmsValue::HK1, "hk1", "HK1" },
+    { EmsValue::HK2, "hk2", "HK2" },
+    { EmsValue::HK3, "hk3", "HK3" },
+    { EmsValue::HK4, "hk4", "HK4" },
+    { EmsValue::Brenner, "burner", "Brenner" },
+    { EmsValue::Kessel, "heater", "Kessel" },
+    { EmsValue::KesselPumpe, "heaterpump", "Kesselpumpe" },
+    { EmsValue::RC, "rc", NULL },
+    { EmsValue::Ruecklauf, "returnflow", "Rücklauf" },
+    { EmsValue::Waermetauscher, "heatexchanger", "Wärmetauscher" },
+    { EmsValue::WW, "ww", "Warmwasser" },
+    { EmsValue::Zirkulation, "zirkpump", "Zirkulation" },
+    { EmsValue::Aussen, "outdoor", "Außen" },
+    { EmsValue::Abgas, "exhaust", "Abgas" },
+    { EmsValue::Ansaugluft, "intake", "Ansaugluft" },
+    { EmsValue::Solar, "solar", "Solar" },
+    { EmsValue::SolarPumpe, "solarpump", NULL },
+    { EmsValue::SolarSpeicher, "solartank", "Solarspeicher" },
+    { EmsValue::SolarKollektor, "solarcollector", "Solarkollektor" }
+};
+
+/* each entry needs to be at the index of its enum value */
+static constexpr bool
+typesInOrder(size_t i)
+{
+    return i == EmsValue::TypeCount || (TYPES[i].type == i && typesInOrder(i + 1));
+}
+static constexpr bool
+subTypesInOrder(size_t i)
+{
+    return i == EmsValue::SubTypeCount || (SUBTYPES[i].subtype == i && subTypesInOrder(i + 1));
+}
+static_assert(sizeof(TYPES) / sizeof(TYPES[0]) == EmsValue::TypeCount, "missing type metadata");
+static_assert(sizeof(SUBTYPES) / sizeof(SUBTYPES[0]) == EmsValue::SubTypeCount, "missing subtype metadata");
+static_assert(typesInOrder(0), "type metadata not in enum order");
+static_assert(subTypesInOrder(0), "subtype metadata not in enum order");
+
+/*
+ * Name lookup is done by hashing into a table with exactly one candidate
+ * per slot. The initial hash values were chosen such that no two names
+ * of the tables share a slot; if names are added, new ones might need to
+ * be searched for.
+ */
+static const size_t TypeSlots = 1024;
+static const uint32_t TypeHashSeed = 0x811c9e21;
+static const size_t SubTypeSlots = 64;
+static const uint32_t SubTypeHashSeed = 0x811c9ddc;
+static const uint8_t EmptySlot = 0xff;
+
+static constexpr size_t
+typeSlot(size_t i)
+{
+    return hashName(TYPES[i].name, TypeHashSeed) & (TypeSlots - 1);
+}
+static constexpr bool
+typeSlotUnique(size_t i, size_t j)
+{
+    return j == EmsValue::TypeCount ||
+	    ((!*TYPES[j].name || typeSlot(i) != typeSlot(j)) && typeSlotUnique(i, j + 1));
+}
+static constexpr bool
+typeSlotsUnique(size_t i)
+{
+    return i == EmsValue::TypeCount ||
+	    ((!*TYPES[i].name || typeSlotUnique(i, i + 1)) && typeSlotsUnique(i + 1));
+}
+
+static constexpr size_t
+subTypeSlot(size_t i)
+{
+    return hashName(SUBTYPES[i].name, SubTypeHashSeed) & (SubTypeSlots - 1);
+}
+static constexpr bool
+subTypeSlotUnique(size_t i, size_t j)
+{
+    return j == EmsValue::SubTypeCount ||
+	    ((!*SUBTYPES[j].name || subTypeSlot(i) != subTypeSlot(j)) && subTypeSlotUnique(i, j + 1));
+}
+static constexpr bool
+subTypeSlotsUnique(size_t i)
+{
+    return i == EmsValue::SubTypeCount ||
+	    ((!*SUBTYPES[i].name || subTypeSlotUnique(i, i + 1)) && subTypeSlotsUnique(i + 1));
+}
+
+static_assert(EmsValue::TypeCount < EmptySlot && EmsValue::SubTypeCount < EmptySlot,
+	      "slot tables can't hold all values");
+static_assert(typeSlotsUnique(0), "type names collide, choose another TypeHashSeed");
+static_assert(subTypeSlotsUnique(0), "subtype names collide, choose another SubTypeHashSeed");
+
+static std::vector<uint8_t>
+buildTypeSlots()
+{
+    std::vector<uint8_t> slots(TypeSlots, EmptySlot);
+    for (size_t i = 0; i < EmsValue::TypeCount; i++) {
+	if (*TYPES[i].name) {
+	    slots[typeSlot(i)] = i;
+	}
+    }
+    return slots;
+}
+
+static std::vector<uint8_t>
+buildSubTypeSlots()
+{
+    std::vector<uint8_t> slots(SubTypeSlots, EmptySlot);
+    for (size_t i = 0; i < EmsValue::SubTypeCount; i++) {
+	if (*SUBTYPES[i].name) {
+	    slots[subTypeSlot(i)] = i;
+	}
+    }
+    return slots;
+}
+
+bool
+ValueMetadata::lookupType(const std::string& name, EmsValue::Type& type)
+{
+    static const std::vector<uint8_t> slots = buildTypeSlots();
+
+    uint8_t index = slots[hashName(name.c_str(), TypeHashSeed) & (TypeSlots - 1)];
+    if (index == EmptySlot || name != TYPES[index].name) {
+	return false;
+    }
+
+    type = (EmsValue::Type) index;
+    return true;
+}
+
+bool
+ValueMetadata::lookupSubType(const std::string& name, EmsValue::SubType& subtype)
+{
+    static const std::vector<uint8_t> slots = buildSubTypeSlots();
+
+    uint8_t index = slots[hashName(name.c_str(), SubTypeHashSeed) & (SubTypeSlots - 1)];
+    if (index == EmptySlot || name != SUBTYPES[index].name) {
+	return false;
+    }
+
+    subtype = (EmsValue::SubType) index;
+    return true;
+}
+
+static bool
+lookupSelectorSubType(const std::string& name, EmsValue::SubType& subtype)
+{
+    /* 'none' selects values without subtype */
+    if (name == "none") {
+	subtype = EmsValue::None;
+	return true;
+    }
+    return ValueMetadata::lookupSubType(name, subtype);
+}
+
+bool
+ValueMetadata::selectValues(const std::vector<std::string>& selector, EmsValueMask& mask)
+{
+    EmsValue::Type type;
+    EmsValue::SubType subtype;
+
+    if (selector.size() > 2) {
+	return false;
+    }
+    if (selector.empty() || (selector[0] == "*" && (selector.size() == 1 || selector[1] == "*"))) {
+	mask |= EmsValueMask::all();
+	return true;
+    }
+
+    if (selector.size() == 1) {
+	/* a single name may be a type, a subtype or both */
+	bool found = false;
+	if (lookupType(selector[0], type)) {
+	    mask.set(type);
+	    found = true;
+	}
+	if (lookupSelectorSubType(selector[0], subtype)) {
+	    mask.set(subtype);
+	    found = true;
+	}
+	return found;
+    }
+
+    if (selector[0] == "*") {
+	if (!lookupType(selector[1], type)) {
+	    return false;
+	}
+	mask.set(type);
+    } else if (!lookupSelectorSubType(selector[0], subtype)) {
+	return false;
+    } else if (selector[1] == "*") {
+	mask.set(subtype);
+    } else if (lookupType(selector[1], type)) {
+	mask.set(type, subtype);
+    } else {
+	return false;
+    }
+    return true;
+}
+
+const EnumLabel *
+ValueMetadata::labels(const EmsValue& value)
+{
+    if (value.getType() == EmsValue::Betriebsart && value.isForHK()) {
+	return HKOPMODELABELS;
+    }
+    return TYPES[value.getType()].labels;
+}
+
+const EnumLabel *
+ValueMetadata::findLabel(const EnumLabel *labels, uint8_t value)
+{
+    if (!labels) {
+	return NULL;
+    }
+    for (; labels->name || labels->description; labels++) {
+	if (labels->value == value) {
+	    return labels;
+	}
+    }
+    return NULL;
+}
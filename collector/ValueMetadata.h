@@ -0,0 +1,96 @@
+/*
+ * Buderus EMS data collector
+ *
+ * Copyright (C) 2011 Danny Baumann <dannybaumann@web.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VALUEMETADATA_H__
+#define __VALUEMETADATA_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "EmsMessage.h"
+
+/*
+ * Names, labels and units of all value types and subtypes, stored in
+ * arrays indexed by the enum value.
+ */
+namespace ValueMetadata {
+    struct EnumLabel {
+	uint8_t value;
+	/* API name, NULL if the value is only known to the descriptive output */
+	const char *name;
+	/* German label for the data debug output, NULL if not shown there */
+	const char *description;
+    };
+
+    struct TypeInfo {
+	EmsValue::Type type;
+	/* API name, empty if the type isn't exposed */
+	const char *name;
+	/* German label for the data debug output, NULL if unknown */
+	const char *description;
+	/* NULL if the value has no unit */
+	const char *unit;
+	/* enumeration values, terminated by an entry without any name */
+	const EnumLabel *labels;
+    };
+
+    struct SubTypeInfo {
+	EmsValue::SubType subtype;
+	/* API name, empty for EmsValue::None */
+	const char *name;
+	const char *description;
+    };
+
+    extern const TypeInfo TYPES[EmsValue::TypeCount];
+    extern const SubTypeInfo SUBTYPES[EmsValue::SubTypeCount];
+    /* day of week, as used by the system time */
+    extern const EnumLabel WEEKDAYS[];
+
+    inline const TypeInfo& type(EmsValue::Type type) {
+	return TYPES[type];
+    }
+    inline const SubTypeInfo& subType(EmsValue::SubType subtype) {
+	return SUBTYPES[subtype];
+    }
+    inline const char * typeName(EmsValue::Type type) {
+	return TYPES[type].name;
+    }
+    inline const char * subTypeName(EmsValue::SubType subtype) {
+	return SUBTYPES[subtype].name;
+    }
+
+    /* the labels to use for the given value, NULL if there are none */
+    const EnumLabel * labels(const EmsValue& value);
+    /* NULL if the value is unknown */
+    const EnumLabel * findLabel(const EnumLabel *labels, uint8_t value);
+
+    /* reverse lookup of API names, false if the name is unknown */
+    bool lookupType(const std::string& name, EmsValue::Type& type);
+    bool lookupSubType(const std::string& name, EmsValue::SubType& subtype);
+    /* adds the values matched by a cache selector ('[<subtype>|none|*] [<type>|*]')
+     * to mask, false if the selector is invalid */
+    bool selectValues(const std::vector<std::string>& selector, EmsValueMask& mask);
+
+    /* FNV-1a, evaluated at compile time for checking the lookup tables */
+    constexpr uint32_t hashName(const char *name, uint32_t hash) {
+	return *name ? hashName(name + 1, (hash ^ (uint8_t) *name) * 16777619U) : hash;
+    }
+}
+
+#endif /* __VALUEMETADATA_H__ */
@@ -29,9 +29,12 @@
 # include "Database.h"
 #endif
 #include "DataHandler.h"
+#include "HttpHandler.h"
+#include "JsonSnapshot.h"
 #include "MqttAdapter.h"
 #include "Options.h"
 #include "PidFile.h"
+#include "ReplayHandler.h"
 #include "SendingSerialHandler.h"
 #include "SerialHandler.h"
 #include "TcpHandler.h"
@@ -51,6 +54,8 @@ getHandler(const std::string& target, ValueCache& cache)
 	    std::string port = target.substr(pos + 1);
 	    return new TcpHandler(host, port, cache);
 	}
+    } else if (target.compare(0, 7, "replay:") == 0) {
+	return new ReplayHandler(target.substr(7), cache);
     }
 
     return nullptr;
@@ -95,7 +100,10 @@ int main(int argc, char *argv[])
     }
 
     try {
-	ValueCache cache;
+	ValueCache cache(Options::historySize(), Options::historyInterval());
+	if (!Options::cacheFile().empty()) {
+	    cache.mapSnapshotFile(Options::cacheFile());
+	}
 	bool running = true;
 
 #ifdef HAVE_DAEMONIZE
@@ -106,6 +114,7 @@ int main(int argc, char *argv[])
 #endif
 
 	IoHandler::ValueCallback dbValueCb;
+	EmsValueMask dbValueMask;
 #ifdef HAVE_MYSQL
 	const std::string& dbPath = Options::databasePath();
 	Database db;
@@ -115,8 +124,9 @@ int main(int argc, char *argv[])
 		std::cerr << "Could not connect to database" << std::endl;
 		return 1;
 	    }
+	    dbValueCb = boost::bind(&Database::handleValues, &db, boost::placeholders::_1);
+	    dbValueMask = Database::interestMask();
 	}
-	dbValueCb = boost::bind(&Database::handleValue,&db, boost::placeholders::_1);
 #endif
 
 #ifdef HAVE_DAEMONIZE
@@ -132,7 +142,7 @@ int main(int argc, char *argv[])
 #endif
 
 	IoHandler::ValueCallback cacheValueCb =
-		boost::bind(&ValueCache::handleValue, &cache, boost::placeholders::_1);
+		boost::bind(&ValueCache::handleValues, &cache, boost::placeholders::_1);
 
 	while (running) {
 	    boost::scoped_ptr<IoHandler> handler(getHandler(Options::target(), cache));
@@ -142,17 +152,22 @@ int main(int argc, char *argv[])
 		throw std::runtime_error(msg.str());
 	    }
 
+	    EmsCommandSender *sender = dynamic_cast<EmsCommandSender *>(handler.get());
+
 	    if (dbValueCb) {
-		handler->addValueCallback(dbValueCb);
+		handler->addValueCallback(dbValueCb, dbValueMask);
 	    }
-	    handler->addValueCallback(cacheValueCb);
-
-	    EmsCommandSender *sender = dynamic_cast<EmsCommandSender *>(handler.get());
+	    /* without any of these, only the decoder reads from the cache */
+	    const std::string& jsonFile = Options::jsonSnapshotFile();
+	    handler->addValueCallback(cacheValueCb,
+		    (sender && Options::commandPort() != 0) || Options::dataPort() != 0 ||
+			    Options::httpPort() != 0 || !jsonFile.empty()
+			    ? EmsValueMask::all() : EmsMessage::lookupMask());
 	    boost::scoped_ptr<MqttAdapter> mqttAdapter(
 		    getMqttAdapter(*handler, sender, Options::mqttTarget()));
 	    if (mqttAdapter) {
 		IoHandler::ValueCallback valueCb =
-			boost::bind(&MqttAdapter::handleValue, mqttAdapter.get(), boost::placeholders::_1);
+			boost::bind(&MqttAdapter::handleValues, mqttAdapter.get(), boost::placeholders::_1);
 		handler->addValueCallback(valueCb);
 	    }
 
@@ -161,24 +176,56 @@ int main(int argc, char *argv[])
 	    if (sender && cmdPort != 0) {
 		boost::asio::ip::tcp::endpoint cmdEndpoint(boost::asio::ip::tcp::v4(), cmdPort);
 		cmdHandler.reset(new CommandHandler(*handler, *sender, *handler, &cache, cmdEndpoint));
+
+		/* registered after the cache, for answering watch commands */
+		IoHandler::ValueCallback valueCb =
+			boost::bind(&CommandHandler::handleValues, cmdHandler.get(), boost::placeholders::_1);
+		handler->addValueCallback(valueCb);
 	    }
 
 	    boost::scoped_ptr<DataHandler> dataHandler;
 	    unsigned int dataPort = Options::dataPort();
+	    unsigned int httpPort = Options::httpPort();
 	    if (dataPort != 0) {
 		boost::asio::ip::tcp::endpoint dataEndpoint(boost::asio::ip::tcp::v4(), dataPort);
-		dataHandler.reset(new DataHandler(*handler, dataEndpoint));
+		dataHandler.reset(new DataHandler(*handler, dataEndpoint, cache));
+	    } else if (httpPort != 0) {
+		/* only for the HTTP event streams */
+		dataHandler.reset(new DataHandler(*handler, cache));
+	    }
+	    if (dataHandler) {
 		IoHandler::ValueCallback valueCb =
-			boost::bind(&DataHandler::handleValue, dataHandler.get(), boost::placeholders::_1);
+			boost::bind(&DataHandler::handleValues, dataHandler.get(), boost::placeholders::_1);
 		handler->addValueCallback(valueCb);
 	    }
 
+	    boost::scoped_ptr<JsonSnapshot> jsonSnapshot;
+	    if (httpPort != 0 || !jsonFile.empty()) {
+		jsonSnapshot.reset(new JsonSnapshot(*handler, cache, jsonFile));
+	    }
+	    if (!jsonFile.empty()) {
+		IoHandler::ValueCallback valueCb =
+			boost::bind(&JsonSnapshot::handleValues, jsonSnapshot.get(), boost::placeholders::_1);
+		handler->addValueCallback(valueCb);
+	    }
+
+	    boost::scoped_ptr<HttpHandler> httpHandler;
+	    if (httpPort != 0) {
+		boost::asio::ip::tcp::endpoint httpEndpoint(boost::asio::ip::tcp::v4(), httpPort);
+		httpHandler.reset(new HttpHandler(*handler, httpEndpoint, cache,
+						  *jsonSnapshot, *dataHandler));
+	    }
+
 	    boost::asio::signal_set signals(*handler);
 	    fillSignalSet(signals);
 	    signals.async_wait(boost::bind(&stopHandler, handler.get(), &running));
 
 	    handler->run();
 
+	    if (!handler->shouldReconnect()) {
+		break;
+	    }
+
 	    /* wait some time until retrying */
 	    if (running) {
 		boost::asio::io_service ios;